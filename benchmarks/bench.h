@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+///measures execution time of the function, prints result as time per operation
+/**
+ * @param name name of the benchmark
+ * @param ops count of operations performed by the function
+ * @param fn function to measure
+ * @return nanoseconds per operation
+ */
+template<typename Fn>
+double measure(std::string_view name, std::size_t ops, Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    double per_op = ns / static_cast<double>(ops);
+    std::cout << std::left << std::setw(48) << name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(2) << per_op << " ns/op"
+              << std::setw(14) << std::setprecision(0) << (1e9 / per_op) << " op/s" << std::endl;
+    return per_op;
+}
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include <basic_coro/coro_frame.hpp>
+#include <basic_coro/dispatch_thread.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+//measures throughput of dispatch_thread::enqueue with multiple producers
+//each producer enqueues a handle of a frame which just counts its resumptions
+
+static constexpr std::size_t total_count = 2000000;
+
+class counting_frame: public coro::coro_frame<counting_frame> {
+public:
+    std::atomic<std::size_t> count = {0};
+    std::size_t target = 0;
+    std::atomic<bool> done = {false};
+
+    void reset(std::size_t t) {
+        count = 0;
+        target = t;
+        done = false;
+    }
+    void wait() {
+        done.wait(false);
+    }
+
+protected:
+    void do_resume() {
+        if (count.fetch_add(1, std::memory_order_relaxed) + 1 == target) {
+            done = true;
+            done.notify_all();
+        }
+    }
+    void do_destroy() {}
+
+    friend coro::coro_frame<counting_frame>;
+};
+
+void run(counting_frame &frm, unsigned int producers) {
+    auto disp = coro::dispatch_thread::create();
+    std::size_t per_producer = total_count / producers;
+    frm.reset(per_producer * producers);
+    std::vector<std::jthread> thrs;
+    for (unsigned int i = 0; i < producers; ++i) {
+        thrs.emplace_back([&]{
+            for (std::size_t j = 0; j < per_producer; ++j) {
+                disp->enqueue(frm.create_handle());
+            }
+        });
+    }
+    thrs.clear();
+    frm.wait();
+}
+
+int main() {
+    counting_frame frm;
+    std::cout << "dispatch_thread::enqueue, " << total_count << " items" << std::endl;
+    for (unsigned int p: {1U, 4U, 16U}) {
+        measure(std::to_string(p) + " producer(s)", total_count, [&]{run(frm, p);});
+    }
+    return 0;
+}
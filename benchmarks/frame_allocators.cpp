@@ -0,0 +1,121 @@
+#include "bench.h"
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/awaitable.hpp>
+#include <basic_coro/pmr_allocator.hpp>
+#include <basic_coro/pool_allocator.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//compares allocators of coroutine frames
+//  objstdalloc - ::operator new / ::operator delete
+//  pool_allocator - thread local size class pool
+//  pmr_allocator<> - default memory resource (new_delete_resource)
+//  pmr_allocator<> - unsynchronized_pool_resource
+
+static constexpr int fibo_n = 25;
+static constexpr std::size_t fibo_frames = 242785; //count of calls of fibo(25)
+static constexpr std::size_t loop_count = 1000000;
+static constexpr std::size_t batch = 256;
+
+coro::coroutine<int> fibo_std(int val) {
+    if (val <= 1) co_return val;
+    int a = co_await fibo_std(val - 1);
+    int b = co_await fibo_std(val - 2);
+    co_return a+b;
+}
+
+coro::coroutine<int, coro::pool_allocator> fibo_pool(int val) {
+    if (val <= 1) co_return val;
+    int a = co_await fibo_pool(val - 1);
+    int b = co_await fibo_pool(val - 2);
+    co_return a+b;
+}
+
+coro::coroutine<int, coro::pmr_allocator<> > fibo_pmr(coro::pmr_allocator<> alloc, int val) {
+    if (val <= 1) co_return val;
+    int a = co_await fibo_pmr(alloc, val - 1);
+    int b = co_await fibo_pmr(alloc, val - 2);
+    co_return a+b;
+}
+
+coro::coroutine<int> simple_std(int val) {co_return val;}
+coro::coroutine<int, coro::pool_allocator> simple_pool(int val) {co_return val;}
+coro::coroutine<int, coro::pmr_allocator<> > simple_pmr(coro::pmr_allocator<>, int val) {co_return val;}
+
+template<typename Fn>
+void loop(Fn &&fn) {
+    long long sum = 0;
+    for (std::size_t i = 0; i < loop_count; ++i) sum += fn(static_cast<int>(i)).get();
+    if (sum == 0) std::cout << "unexpected" << std::endl;
+}
+
+//producer creates coroutines, consumer thread destroys them
+template<typename Fn>
+void cross_thread(Fn &&fn) {
+    using coro_t = decltype(fn(0));
+    std::mutex mx;
+    std::condition_variable cv;
+    std::vector<coro_t> shared;
+    bool done = false;
+    std::thread consumer([&]{
+        std::vector<coro_t> local;
+        while (true) {
+            {
+                std::unique_lock lk(mx);
+                cv.wait(lk, [&]{return !shared.empty() || done;});
+                if (shared.empty()) break;
+                std::swap(local, shared);
+            }
+            cv.notify_one();
+            for (auto &c: local) c.cancel();
+            local.clear();
+        }
+    });
+    std::vector<coro_t> local;
+    for (std::size_t i = 0; i < loop_count; ++i) {
+        local.push_back(fn(static_cast<int>(i)));
+        if (local.size() == batch) {
+            std::unique_lock lk(mx);
+            cv.wait(lk, [&]{return shared.empty();});
+            std::swap(local, shared);
+            cv.notify_one();
+        }
+    }
+    {
+        std::unique_lock lk(mx);
+        cv.wait(lk, [&]{return shared.empty();});
+        std::swap(local, shared);
+        done = true;
+    }
+    cv.notify_one();
+    consumer.join();
+}
+
+int main() {
+    std::pmr::unsynchronized_pool_resource pool_res;
+    coro::pmr_allocator<> pmr_default;
+    coro::pmr_allocator<> pmr_pool(&pool_res);
+
+    std::cout << "recursive fibo(" << fibo_n << ")" << std::endl;
+    measure("objstdalloc", fibo_frames, []{fibo_std(fibo_n).get();});
+    measure("pool_allocator", fibo_frames, []{fibo_pool(fibo_n).get();});
+    measure("pmr_allocator (new_delete_resource)", fibo_frames, [&]{fibo_pmr(pmr_default, fibo_n).get();});
+    measure("pmr_allocator (unsynchronized_pool_resource)", fibo_frames, [&]{fibo_pmr(pmr_pool, fibo_n).get();});
+
+    std::cout << std::endl << "create / await / destroy" << std::endl;
+    measure("objstdalloc", loop_count, []{loop(simple_std);});
+    measure("pool_allocator", loop_count, []{loop(simple_pool);});
+    measure("pmr_allocator (new_delete_resource)", loop_count, [&]{loop([&](int i){return simple_pmr(pmr_default, i);});});
+    measure("pmr_allocator (unsynchronized_pool_resource)", loop_count, [&]{loop([&](int i){return simple_pmr(pmr_pool, i);});});
+
+    std::cout << std::endl << "allocate in producer thread, free in consumer thread" << std::endl;
+    std::pmr::synchronized_pool_resource sync_pool_res;
+    coro::pmr_allocator<> pmr_sync_pool(&sync_pool_res);
+    measure("objstdalloc", loop_count, []{cross_thread(simple_std);});
+    measure("pool_allocator", loop_count, []{cross_thread(simple_pool);});
+    measure("pmr_allocator (new_delete_resource)", loop_count, [&]{cross_thread([&](int i){return simple_pmr(pmr_default, i);});});
+    measure("pmr_allocator (synchronized_pool_resource)", loop_count, [&]{cross_thread([&](int i){return simple_pmr(pmr_sync_pool, i);});});
+    return 0;
+}
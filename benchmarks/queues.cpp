@@ -0,0 +1,116 @@
+#include "bench.h"
+#include <basic_coro/mpmc_queue.hpp>
+#include <basic_coro/spsc_queue.hpp>
+#include <basic_coro/sync_await.hpp>
+#include <algorithm>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+//compares basic_queue with a mutex (queue<T,N,std::mutex>) against lock-free mpmc_queue
+//(and spsc_queue for single producer and consumer)
+//N producers and N consumers exchange total_count items through a queue of capacity 1024
+
+static constexpr std::size_t total_count = 2000000;
+static constexpr unsigned int capacity = 1024;
+static constexpr std::size_t batch_size = 64;
+
+template<typename Queue>
+coro::coroutine<void> producer(Queue &q, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        co_await q.push(static_cast<int>(i));
+    }
+}
+
+template<typename Queue>
+coro::coroutine<void> consumer(Queue &q, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        co_await q.pop();
+    }
+}
+
+template<typename Queue>
+coro::coroutine<void> batch_producer(Queue &q, std::size_t count) {
+    std::vector<int> items(batch_size);
+    for (std::size_t i = 0; i < count; i += batch_size) {
+        co_await q.push_many(std::span<int>(items.data(), std::min(batch_size, count - i)));
+    }
+}
+
+template<typename Queue>
+coro::coroutine<void> batch_consumer(Queue &q, std::size_t count) {
+    std::vector<int> buff(batch_size);
+    while (count) {
+        count -= co_await q.pop_many(std::span<int>(buff.data(), std::min(batch_size, count)));
+    }
+}
+
+template<typename Queue>
+void run_batch(unsigned int threads) {
+    Queue q;
+    std::size_t per_thread = total_count / threads;
+    std::vector<std::jthread> thrs;
+    for (unsigned int i = 0; i < threads; ++i) {
+        thrs.emplace_back([&]{
+            coro::awaitable<void> p = batch_producer(q, per_thread);
+            coro::sync_await(p);
+        });
+        thrs.emplace_back([&]{
+            coro::awaitable<void> c = batch_consumer(q, per_thread);
+            coro::sync_await(c);
+        });
+    }
+}
+
+template<typename Queue>
+void run(unsigned int threads) {
+    Queue q;
+    std::size_t per_thread = total_count / threads;
+    std::vector<std::jthread> thrs;
+    for (unsigned int i = 0; i < threads; ++i) {
+        thrs.emplace_back([&]{
+            coro::awaitable<void> p = producer(q, per_thread);
+            coro::sync_await(p);
+        });
+        thrs.emplace_back([&]{
+            coro::awaitable<void> c = consumer(q, per_thread);
+            coro::sync_await(c);
+        });
+    }
+}
+
+//fast path only: one thread pushes and pops bursts, which never suspends
+//it runs in other thread, because glibc skips atomics of std::mutex in a single-threaded process
+template<typename Queue>
+void run_burst() {
+    std::jthread thr([]{
+        Queue q;
+        for (std::size_t i = 0; i < total_count; i += capacity) {
+            for (unsigned int j = 0; j < capacity; ++j) q.push(static_cast<int>(j));
+            for (unsigned int j = 0; j < capacity; ++j) q.pop();
+        }
+    });
+}
+
+int main() {
+    std::cout << "fast path (no suspension), " << total_count << " items" << std::endl;
+    measure("queue<int,N,std::mutex>", total_count, run_burst<coro::queue<int, capacity, std::mutex> >);
+    measure("mpmc_queue<int,N>", total_count, run_burst<coro::mpmc_queue<int, capacity> >);
+    measure("spsc_queue<int,N>", total_count, run_burst<coro::spsc_queue<int, capacity> >);
+    std::cout << "queue push/pop, " << total_count << " items, capacity " << capacity << std::endl;
+    for (unsigned int t: {1U, 2U, 4U, 8U}) {
+        std::string thr = std::to_string(t) + "P/" + std::to_string(t) + "C";
+        measure("queue<int,N,std::mutex> " + thr, total_count, [&]{run<coro::queue<int, capacity, std::mutex> >(t);});
+        measure("mpmc_queue<int,N> " + thr, total_count, [&]{run<coro::mpmc_queue<int, capacity> >(t);});
+        if (t == 1) measure("spsc_queue<int,N> " + thr, total_count, [&]{run<coro::spsc_queue<int, capacity> >(t);});
+    }
+    std::cout << "push_many/pop_many, batch " << batch_size << std::endl;
+    for (unsigned int t: {1U, 4U}) {
+        std::string thr = std::to_string(t) + "P/" + std::to_string(t) + "C";
+        measure("queue<int,N,std::mutex> " + thr, total_count, [&]{run_batch<coro::queue<int, capacity, std::mutex> >(t);});
+        measure("mpmc_queue<int,N> " + thr, total_count, [&]{run_batch<coro::mpmc_queue<int, capacity> >(t);});
+    }
+    return 0;
+}
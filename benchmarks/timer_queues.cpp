@@ -0,0 +1,62 @@
+#include "bench.h"
+#include <basic_coro/scheduler.hpp>
+#include <basic_coro/timing_wheel.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+//compares timer queues of the scheduler
+//  generic_scheduler - indexed 4-ary heap
+//  timing_wheel - hierarchical timing wheel, 1ms resolution
+//timers are spread randomly over 60 seconds from now
+
+using time_point = std::chrono::steady_clock::time_point;
+using heap_queue = coro::generic_scheduler<int, time_point, const void *>;
+using wheel_queue = coro::timing_wheel<int, time_point, const void *>;
+
+//count of rescheduled and canceled timers
+static constexpr std::size_t cancel_count = 200;
+
+template<typename Queue>
+void run(const char *name, std::size_t count) {
+    std::vector<char> idents(count);
+    std::vector<time_point> times(count);
+    std::mt19937_64 rnd(1);
+    time_point base = std::chrono::steady_clock::now();
+    for (auto &t: times) t = base + std::chrono::microseconds(rnd() % 60000000);
+    std::vector<std::size_t> cancels(cancel_count);
+    for (auto &c: cancels) c = rnd() % count;
+
+    Queue q;
+    //a long running scheduler has its queue positioned near current time
+    q.schedule_at(0, base, nullptr);
+    q.remove_first();
+    std::string n(name);
+    measure(n + " insert", count, [&]{
+        for (std::size_t i = 0; i < count; ++i) q.schedule_at(1, times[i], &idents[i]);
+    });
+    measure(n + " reschedule", cancel_count, [&]{
+        for (auto c: cancels) q.set_time(&idents[c], times[c] + std::chrono::seconds(1));
+    });
+    measure(n + " cancel", cancel_count, [&]{
+        for (auto c: cancels) q.remove_by_ident(&idents[c]);
+    });
+    std::size_t remain = 0;
+    measure(n + " expire", count - cancel_count, [&]{
+        while (!q.empty()) {
+            q.get_first_scheduled_time();
+            remain += static_cast<std::size_t>(q.remove_first());
+        }
+    });
+    if (remain + cancel_count < count) std::cout << "unexpected" << std::endl;
+}
+
+int main() {
+    for (std::size_t count: {std::size_t(10000), std::size_t(1000000), std::size_t(10000000)}) {
+        std::cout << count << " timers" << std::endl;
+        run<heap_queue>("heap", count);
+        run<wheel_queue>("wheel", count);
+        std::cout << std::endl;
+    }
+    return 0;
+}
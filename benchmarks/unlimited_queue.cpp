@@ -0,0 +1,58 @@
+#include "bench.h"
+#include <basic_coro/queue.hpp>
+#include <deque>
+
+//compares chunked unlimited_queue (queue<T,0>) against the former std::deque based implementation
+
+//former implementation (with FIFO pop)
+template<typename T>
+struct deque_queue {
+    using value_type = T;
+    static constexpr bool is_full() {return false;}
+    bool is_empty() const {return _q.empty();}
+    template<typename ... Args>
+    void push(Args && ... args) {_q.emplace_back(std::forward<Args>(args)...);}
+    T pop() {
+        T r = std::move(_q.front());
+        _q.pop_front();
+        return r;
+    }
+    std::deque<T> _q;
+};
+
+static constexpr std::size_t total_count = 10000000;
+
+//queue fills to 'depth' items and drains completely, repeatedly
+template<typename Queue>
+void breathing(std::size_t depth) {
+    Queue q;
+    for (std::size_t i = 0; i < total_count; i += depth) {
+        for (std::size_t j = 0; j < depth; ++j) q.push(static_cast<int>(j));
+        for (std::size_t j = 0; j < depth; ++j) q.pop();
+    }
+}
+
+//queue holds 'depth' items, every push is followed by a pop
+template<typename Queue>
+void steady(std::size_t depth) {
+    Queue q;
+    for (std::size_t j = 0; j < depth; ++j) q.push(static_cast<int>(j));
+    for (std::size_t i = 0; i < total_count; ++i) {
+        q.push(static_cast<int>(i));
+        q.pop();
+    }
+}
+
+int main() {
+    using old_queue = coro::basic_queue<deque_queue<int> >;
+    using new_queue = coro::queue<int>;
+    std::cout << "unlimited queue, " << total_count << " items" << std::endl;
+    for (std::size_t depth: {16, 1000, 100000}) {
+        std::string d = std::to_string(depth);
+        measure("deque   breathing depth " + d, total_count, [&]{breathing<old_queue>(depth);});
+        measure("chunked breathing depth " + d, total_count, [&]{breathing<new_queue>(depth);});
+        measure("deque   steady depth " + d, total_count, [&]{steady<old_queue>(depth);});
+        measure("chunked steady depth " + d, total_count, [&]{steady<new_queue>(depth);});
+    }
+    return 0;
+}
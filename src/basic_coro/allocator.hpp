@@ -11,6 +11,15 @@ namespace coro {
  */
 class objstdalloc {
 public:
+    ///allocate memory
+    static void *allocate(std::size_t sz) {
+        return ::operator new(sz);
+    }
+    ///deallocate memory
+    static void deallocate(void *ptr, std::size_t) {
+        ::operator delete(ptr);
+    }
+
     struct overrides {
         template<typename ... Args>
         void *operator new(std::size_t sz, Args && ...) {
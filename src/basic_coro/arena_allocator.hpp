@@ -0,0 +1,458 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "coroutine.hpp"
+#include "awaitable.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace coro {
+
+class arena_pool;
+
+///monotonic memory arena for coroutine frames of one request
+/**
+ * The arena allocates frames by moving a pointer inside of a chunk. Deallocation
+ * of a frame doesn't release any memory, it only decrements counter of references. Once
+ * the last reference is released, whole arena is released at once - it is reset to
+ * initial state and it is eventually returned to the arena_pool (if it was acquired
+ * from a pool).
+ *
+ * References are held by every allocated frame and by every arena_ptr
+ *
+ * Allocation is MT-Safe, so frames of one request can be allocated in multiple threads
+ *
+ * @see arena_allocator, arena_pool, arena_scope
+ */
+class request_arena {
+public:
+
+    static constexpr std::size_t default_chunk_size = 16384;
+
+    ///construct arena
+    /**
+     * @param chunk_size size of one chunk in bytes. Larger allocations get own chunk
+     */
+    explicit request_arena(std::size_t chunk_size = default_chunk_size)
+        :_chunk_size(chunk_size) {
+        _first = _current = alloc_chunk(chunk_size, nullptr);
+    }
+
+    request_arena(const request_arena &) = delete;
+    request_arena &operator=(const request_arena &) = delete;
+
+    ///destructor - releases all chunks
+    /**
+     * @note there must be no references to the arena
+     */
+    ~request_arena() {
+        free_chunks(_first);
+    }
+
+    ///allocate memory
+    /**
+     * @param sz size in bytes
+     * @return pointer to allocated memory. It is aligned to alignof(std::max_align_t)
+     *
+     * @note the function adds a reference to the arena
+     */
+    void *allocate(std::size_t sz) {
+        sz = align_up(sz);
+        _refs.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+            chunk *c = _current.load(std::memory_order_acquire);
+            std::size_t off = c->used.fetch_add(sz, std::memory_order_relaxed);
+            if (off + sz <= c->size) return c->data() + off;
+            std::lock_guard _(_mx);
+            if (_current.load(std::memory_order_relaxed) == c) {
+                chunk *n = alloc_chunk(std::max(_chunk_size, sz), nullptr);
+                c->next = n;
+                _current.store(n, std::memory_order_release);
+            }
+        }
+    }
+
+    ///add reference
+    void add_ref() {
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ///release reference
+    /**
+     * When the last reference is released, arena is reset and returned to the pool
+     */
+    void release();
+
+    ///retrieve count of bytes allocated in chunks (including unused space)
+    std::size_t get_reserved() const {
+        std::lock_guard _(_mx);
+        std::size_t sz = 0;
+        for (const chunk *c = _first; c; c = c->next) sz += c->size;
+        return sz;
+    }
+
+    ///retrieve count of references (live frames + arena_ptr instances)
+    std::size_t get_ref_count() const {
+        return _refs.load(std::memory_order_relaxed);
+    }
+
+    ///retrieve arena associated with current thread
+    /**
+     * @return pointer to arena of running coroutine, or arena of current arena_scope,
+     * or nullptr if there is no arena
+     * @see arena_scope
+     */
+    static request_arena *current() {
+        auto &c = context();
+        return c.coro?c.coro:c.scope;
+    }
+
+    ///align size to alignment of frame
+    static constexpr std::size_t align_up(std::size_t sz) {
+        return (sz + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    }
+
+protected:
+
+    struct chunk {
+        chunk *next;
+        std::size_t size;
+        std::atomic<std::size_t> used;
+
+        char *data() {return reinterpret_cast<char *>(this) + header_size();}
+        static constexpr std::size_t header_size() {return align_up(sizeof(chunk));}
+    };
+
+    mutable std::mutex _mx;
+    std::atomic<chunk *> _current;
+    chunk *_first;
+    std::size_t _chunk_size;
+    std::atomic<std::size_t> _refs = {0};
+    arena_pool *_pool = nullptr;
+
+    struct thread_context {
+        //arena set by arena_scope
+        request_arena *scope = nullptr;
+        //arena of running coroutine (overrides scope)
+        request_arena *coro = nullptr;
+    };
+
+    static thread_context &context() {
+        static thread_local thread_context ctx;
+        return ctx;
+    }
+
+    static chunk *alloc_chunk(std::size_t sz, chunk *next) {
+        void *ptr = ::operator new(chunk::header_size() + sz);
+        return new(ptr) chunk{next, sz, {0}};
+    }
+
+    static void free_chunks(chunk *c) {
+        while (c) {
+            chunk *n = c->next;
+            std::destroy_at(c);
+            ::operator delete(c);
+            c = n;
+        }
+    }
+
+    //release all chunks except the first one. Called when there are no references
+    void reset() {
+        free_chunks(_first->next);
+        _first->next = nullptr;
+        _first->used.store(0, std::memory_order_relaxed);
+        _current.store(_first, std::memory_order_relaxed);
+    }
+
+    friend class arena_pool;
+    friend class arena_scope;
+    friend class arena_allocator;
+};
+
+///holds reference to the request_arena
+/**
+ * While the object is alive, the arena cannot be released. Once the reference
+ * is released and all frames allocated from the arena are destroyed, the arena is
+ * released (returned to the pool)
+ */
+class arena_ptr {
+public:
+    arena_ptr() = default;
+    explicit arena_ptr(request_arena *a):_ptr(a) {if (_ptr) _ptr->add_ref();}
+    arena_ptr(const arena_ptr &other):arena_ptr(other._ptr) {}
+    arena_ptr(arena_ptr &&other):_ptr(std::exchange(other._ptr, nullptr)) {}
+    arena_ptr &operator=(arena_ptr other) {
+        std::swap(_ptr, other._ptr);
+        return *this;
+    }
+    ~arena_ptr() {reset();}
+
+    ///release reference
+    void reset() {
+        auto p = std::exchange(_ptr, nullptr);
+        if (p) p->release();
+    }
+
+    request_arena *get() const {return _ptr;}
+    request_arena *operator->() const {return _ptr;}
+    request_arena &operator*() const {return *_ptr;}
+    explicit operator bool() const {return _ptr != nullptr;}
+
+protected:
+    request_arena *_ptr = nullptr;
+};
+
+///pool of arenas
+/**
+ * Arenas are recycled, so there is no need to allocate new chunks for every request.
+ *
+ * @note MT-Safe
+ * @note the pool must stay valid while any of its arenas are in use
+ */
+class arena_pool {
+public:
+    ///construct pool
+    /**
+     * @param chunk_size size of chunk of created arenas
+     * @param max_idle maximum count of idle arenas held by the pool
+     */
+    explicit arena_pool(std::size_t chunk_size = request_arena::default_chunk_size, std::size_t max_idle = 16)
+        :_chunk_size(chunk_size),_max_idle(max_idle) {}
+
+    arena_pool(const arena_pool &) = delete;
+    arena_pool &operator=(const arena_pool &) = delete;
+
+    ~arena_pool() {
+        for (auto x: _idle) delete x;
+    }
+
+    ///acquire arena from pool
+    /**
+     * @return reference to the arena
+     */
+    arena_ptr acquire() {
+        request_arena *a = nullptr;
+        {
+            std::lock_guard _(_mx);
+            if (!_idle.empty()) {
+                a = _idle.back();
+                _idle.pop_back();
+            }
+        }
+        if (!a) {
+            a = new request_arena(_chunk_size);
+            a->_pool = this;
+        }
+        return arena_ptr(a);
+    }
+
+    ///retrieve count of idle arenas
+    std::size_t get_idle_count() const {
+        std::lock_guard _(_mx);
+        return _idle.size();
+    }
+
+protected:
+    mutable std::mutex _mx;
+    std::vector<request_arena *> _idle;
+    std::size_t _chunk_size;
+    std::size_t _max_idle;
+
+    void recycle(request_arena *a) {
+        a->reset();
+        {
+            std::lock_guard _(_mx);
+            if (_idle.size() < _max_idle) {
+                _idle.push_back(a);
+                return;
+            }
+        }
+        delete a;
+    }
+
+    friend class request_arena;
+};
+
+inline void request_arena::release() {
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (_pool) _pool->recycle(this);
+        else reset();
+    }
+}
+
+///sets arena for current thread while the object exists
+/**
+ * Coroutines declared with arena_allocator, which are created in the scope
+ * are allocated in the arena
+ *
+ * @code
+ * auto arena = pool.acquire();
+ * arena_scope _(arena.get());
+ * auto res = handle_request(args);   //allocated in arena
+ * @endcode
+ *
+ * You can pass nullptr to temporarily disable allocation in the arena
+ */
+class arena_scope {
+public:
+    explicit arena_scope(request_arena *a):_prev(std::exchange(request_arena::context(), {a, nullptr})) {}
+    ~arena_scope() {request_arena::context() = _prev;}
+    arena_scope(const arena_scope &) = delete;
+    arena_scope &operator=(const arena_scope &) = delete;
+protected:
+    request_arena::thread_context _prev;
+};
+
+
+///coroutine allocator which allocates frames from the current request_arena
+/**
+ * The allocator doesn't need to be passed as an argument. The frame is allocated
+ * in the arena associated with the current thread (see arena_scope). If there is no such
+ * arena, the frame is allocated on the heap.
+ *
+ * The arena is inherited. The coroutine associates its arena with the current thread
+ * while it is running (the association is set when the coroutine starts and after every
+ * resumption through co_await). So nested coroutines created by the coroutine are allocated
+ * in the same arena, even if the coroutine was resumed in a different thread. When the
+ * coroutine suspends (including symmetric transfer to other coroutine) or finishes,
+ * the association is removed.
+ *
+ * @code
+ * coroutine<int, arena_allocator> handle_request(int x) {
+ *      int a = co_await sub_request(x);      //sub_request is also allocated in arena
+ *      co_return a;
+ * }
+ * @endcode
+ *
+ * @note arena_scope created inside of the coroutine overrides the coroutine's arena. You
+ * can use arena_scope(nullptr) to create a coroutine outside of the request
+ */
+class arena_allocator {
+public:
+
+    ///wraps awaiter to associate the arena with the thread
+    template<typename Awt>
+    class awaiter {
+    public:
+        awaiter(Awt awt, request_arena *arena):_awt(std::forward<Awt>(awt)),_arena(arena) {}
+        bool await_ready() {return _awt.await_ready();}
+        template<typename Promise>
+        auto await_suspend(std::coroutine_handle<Promise> h) {
+            auto &ctx = request_arena::context();
+            ctx.coro = _arena;
+            using Ret = decltype(_awt.await_suspend(h));
+            if constexpr(std::is_void_v<Ret>) {
+                _awt.await_suspend(h);
+                ctx.coro = nullptr;
+            } else if constexpr(std::is_convertible_v<Ret, bool>) {
+                bool b = _awt.await_suspend(h);
+                if (b) ctx.coro = nullptr;
+                return b;
+            } else {
+                std::coroutine_handle<> r = _awt.await_suspend(h);
+                //the target of symmetric transfer doesn't need to be arena coroutine, it
+                //could suspend with the arena still associated with the thread. Arena
+                //coroutines set their arena when they start (see initial_awaiter)
+                ctx.coro = nullptr;
+                return r;
+            }
+        }
+        decltype(auto) await_resume() {
+            request_arena::context().coro = _arena;
+            return std::forward<Awt>(_awt).await_resume();
+        }
+    protected:
+        Awt _awt;
+        request_arena *_arena;
+    };
+
+    ///initial suspend of arena coroutine - associates the arena with the thread when the coroutine starts
+    struct initial_awaiter: std::suspend_always {
+        request_arena *_arena;
+        void await_resume() noexcept {request_arena::context().coro = _arena;}
+    };
+
+    struct overrides {
+        template<typename ... Args>
+        void *operator new(std::size_t sz, Args && ...) {
+            request_arena *a = request_arena::current();
+            std::size_t total = trailer_offset(sz) + sizeof(request_arena *);
+            void *ptr = a?a->allocate(total):(::operator new(total));
+            *reinterpret_cast<request_arena **>(ptr_plus_bytes(ptr, trailer_offset(sz))) = a;
+            return ptr;
+        }
+        void operator delete(void *ptr, std::size_t sz) {
+            request_arena *a = *reinterpret_cast<request_arena **>(ptr_plus_bytes(ptr, trailer_offset(sz)));
+            if (a) a->release();
+            else ::operator delete(ptr);
+        }
+
+        template<is_awaitable Awt>
+        auto await_transform(Awt &&awt) {
+            using A = decltype(extract_awaiter(std::forward<Awt>(awt)));
+            return awaiter<A>(extract_awaiter(std::forward<Awt>(awt)), _arena);
+        }
+
+        ///wraps initial suspend (called by coroutine's promise)
+        initial_awaiter wrap_initial_suspend(std::suspend_always) noexcept {
+            return {{}, _arena};
+        }
+
+        ///retrieve arena of this coroutine (nullptr if allocated on heap)
+        request_arena *get_arena() const {return _arena;}
+
+        overrides() = default;
+        overrides(const overrides &) = delete;
+        overrides &operator=(const overrides &) = delete;
+        ~overrides() {
+            auto &ctx = request_arena::context();
+            if (ctx.coro == _arena) ctx.coro = nullptr;
+        }
+
+    protected:
+        //promise is constructed in the same context as frame allocation
+        request_arena *_arena = request_arena::current();
+    };
+
+protected:
+    static constexpr std::ptrdiff_t trailer_offset(std::size_t sz) {
+        return static_cast<std::ptrdiff_t>((sz + alignof(request_arena *) - 1) & ~(alignof(request_arena *) - 1));
+    }
+};
+
+static_assert(coro_allocator<arena_allocator>);
+
+namespace details {
+
+    template<typename T>
+    coroutine<T, arena_allocator> arena_root(arena_ptr, awaitable<T> awt) {
+        co_return co_await awt;
+    }
+
+}
+
+///run request in new arena
+/**
+ * @param arena reference to arena (use arena_pool::acquire())
+ * @param fn function which starts the request. It is called in scope of the arena, so
+ * it can call coroutines declared with arena_allocator.
+ * @return coroutine which represents whole request. When this coroutine finishes, reference
+ * to the arena is released. The arena is then released (recycled) once all frames are destroyed
+ *
+ * @code
+ * int res = co_await run_in_arena(pool.acquire(), [&]{return handle_request(args);});
+ * @endcode
+ */
+template<std::invocable<> Fn>
+auto run_in_arena(arena_ptr arena, Fn &&fn) {
+    using R = awaiter_result<std::invoke_result_t<Fn> >;
+    using T = std::conditional_t<std::is_rvalue_reference_v<R>, std::remove_reference_t<R>, R>;
+    arena_scope _(arena.get());
+    awaitable<T> awt(std::forward<Fn>(fn)());
+    return details::arena_root<T>(std::move(arena), std::move(awt));
+}
+
+}
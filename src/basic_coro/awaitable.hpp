@@ -4,9 +4,15 @@
 #include "await_proxy.hpp"
 #include "coroutine.hpp"
 #include "pending.hpp"
+#include "pool_allocator.hpp"
+#include "trace.hpp"
 #include <exception>
 #include <optional>
 #include <memory>
+#include <new>
+#ifdef BASIC_CORO_ENABLE_TRACE
+#include <typeinfo>
+#endif
 
 
 namespace coro {
@@ -165,6 +171,32 @@ struct awaitable_reserved_space {
     static constexpr std::size_t value = 4*sizeof(void *);
 };
 
+///allows to override allocator used for callbacks which don't fit into reserved space
+/**
+ * @tparam parameter type of awaitable<T>
+ *
+ * The type must declare static functions allocate(size) and deallocate(ptr, size). Default
+ * allocator is pool_allocator, which holds released blocks in thread local free lists, so
+ * repeated operations don't need to call ::operator new. Callbacks released during the exit
+ * of the program (for example pending in a global object) bypass the already destroyed
+ * thread cache. You can specialize this template to use objstdalloc or own allocator
+ *
+ * To find which callbacks don't fit into reserved space, define BASIC_CORO_WARN_CALLBACK_SPILL
+ * (compiler emits a warning for every such callback type) or enable trace and
+ * implement basic_coro_trace_callback_spill()
+ */
+template<typename T>
+struct awaitable_callback_allocator {
+    using type = pool_allocator;
+};
+
+#ifdef BASIC_CORO_WARN_CALLBACK_SPILL
+///called at compile time when callback doesn't fit into reserved space of awaitable<T>
+template<typename T, typename Fn>
+[[deprecated("callback Fn doesn't fit into awaitable_reserved_space<T>, consider to specialize awaitable_reserved_space")]]
+constexpr void awaitable_callback_spill_warning() {}
+#endif
+
 
 ///Awatable object. Indicates asynchronous result
 /**
@@ -225,14 +257,52 @@ public:
     ///this class is used to hold dynamically allocated callback (on heap), acting as its proxy
     /**
      * @tparam Fn callback function (closure)
+     *
+     * The callback is allocated by awaitable_callback_allocator<T>
      */
     template<typename Fn>
     class DynamicAllocatedCB {
     public:
-        DynamicAllocatedCB(Fn &&fn): _ptr(std::make_unique<Fn>(std::forward<Fn>(fn))) {}
-        prepared_coro operator()(result r) {return (*_ptr)(std::move(r));}
+        ///over-aligned callbacks are allocated by aligned operator new
+        struct overaligned_allocator {
+            static void *allocate(std::size_t sz) {
+                return ::operator new(sz, std::align_val_t{alignof(Fn)});
+            }
+            static void deallocate(void *ptr, std::size_t sz) {
+                ::operator delete(ptr, sz, std::align_val_t{alignof(Fn)});
+            }
+        };
+
+        using allocator = std::conditional_t<(alignof(Fn) > alignof(std::max_align_t)),
+                        overaligned_allocator, typename awaitable_callback_allocator<T>::type>;
+
+        DynamicAllocatedCB(Fn &&fn) {
+            void *ptr = allocator::allocate(sizeof(Fn));
+            try {
+                _ptr = new(ptr) Fn(std::forward<Fn>(fn));
+            } catch (...) {
+                allocator::deallocate(ptr, sizeof(Fn));
+                throw;
+            }
+        }
+        DynamicAllocatedCB(DynamicAllocatedCB &&other):_ptr(std::exchange(other._ptr, nullptr)) {}
+        DynamicAllocatedCB &operator=(DynamicAllocatedCB &&other) = delete;
+        ~DynamicAllocatedCB() {
+            if (_ptr) {
+                std::destroy_at(_ptr);
+                allocator::deallocate(_ptr, sizeof(Fn));
+            }
+        }
+        prepared_coro operator()(result r) {
+            if constexpr(std::is_convertible_v<std::invoke_result_t<Fn, result>, prepared_coro>) {
+                return (*_ptr)(std::move(r));
+            } else {
+                (*_ptr)(std::move(r));
+                return {};
+            }
+        }
     protected:
-        std::unique_ptr<Fn> _ptr;
+        Fn *_ptr = nullptr;
     };
 
     ///declaraton of constexpr method table for function Fn
@@ -292,6 +362,12 @@ public:
             _vtable = &cbvtable<Fn>;
 
         } else {
+            #ifdef BASIC_CORO_WARN_CALLBACK_SPILL
+            awaitable_callback_spill_warning<T, Fn>();
+            #endif
+            #ifdef BASIC_CORO_ENABLE_TRACE
+            basic_coro_trace_callback_spill(typeid(Fn).name(), sizeof(Fn), callback_max_size);
+            #endif
             new(_callback_space) DynamicAllocatedCB<Fn>(std::forward<Fn>(fn));
             _vtable = &cbvtable<DynamicAllocatedCB<Fn> >;
         }
@@ -9,9 +9,20 @@
 #include "when_each.hpp"
 #include "scheduler.hpp"
 #include "distributor.hpp"
+#include "multicast_ring.hpp"
 #include "async_generator.hpp"
 #include "mutex.hpp"
+#include "shared_mutex.hpp"
 #include "queue.hpp"
+#include "queue_stats.hpp"
+#include "mpmc_queue.hpp"
+#include "spsc_queue.hpp"
+#include "priority_queue.hpp"
+#include "select.hpp"
 #include "aggregator.hpp"
 #include "pmr_allocator.hpp"
-#include "flat_stack_allocator.hpp"
\ No newline at end of file
+#include "flat_stack_allocator.hpp"
+#include "pool_allocator.hpp"
+#include "arena_allocator.hpp"
+#include "memory_budget.hpp"
+#include "thread_pool.hpp"
\ No newline at end of file
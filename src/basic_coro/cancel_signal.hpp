@@ -1,5 +1,6 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
 
 namespace coro {
 
@@ -23,6 +24,17 @@ namespace coro {
         bool is_canceled() const {return this->load(std::memory_order_relaxed);}
         ///Reset the cancel signal to false. This does not interrupt any operation by itself, but allows to reuse the same signal for future operations.
         void reset() {this->store(false, std::memory_order_relaxed);}
+
+        ///value of slot hint, when the signal is not registered
+        static constexpr std::size_t no_slot = ~std::size_t(0);
+        ///Retrieve position of the registration in the container of the operation (used for O(1) cancelation)
+        /** It is only a hint, the container must verify, that the slot belongs to this signal */
+        std::size_t get_slot_hint() const {return _slot_hint.load(std::memory_order_relaxed);}
+        ///Store position of the registration in the container of the operation
+        void set_slot_hint(std::size_t slot) {_slot_hint.store(slot, std::memory_order_relaxed);}
+
+    protected:
+        std::atomic<std::size_t> _slot_hint = {no_slot};
     };
         
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+
+namespace coro {
+
+///Token which decides, which of competing operations completes
+/**
+ * Multiple waiters can share the same winner variable (for example cases of select()).
+ * The first waiter which calls claim() wins, other claims fail. Owner of a waiter which
+ * failed to claim must not resolve it with a value.
+ *
+ * Default constructed token doesn't compete, its claim() always succeeds
+ */
+class claim_token {
+public:
+
+    claim_token() = default;
+
+    ///construct the token
+    /**
+     * @param winner shared variable, contains id of the winner or zero if there is no winner yet
+     * @param id identification of this token, must not be zero
+     */
+    claim_token(std::atomic<unsigned int> &winner, unsigned int id):_winner(&winner),_id(id) {}
+
+    ///try to claim
+    /**
+     * @retval true claimed, the owner can resolve the waiter
+     * @retval false other token already won
+     */
+    bool claim() const {
+        if (!_winner) return true;
+        unsigned int need = 0;
+        return _winner->compare_exchange_strong(need, _id, std::memory_order_acq_rel);
+    }
+
+    ///determine whether token competes with other tokens
+    explicit operator bool() const {return _winner != nullptr;}
+
+protected:
+    std::atomic<unsigned int> *_winner = nullptr;
+    unsigned int _id = 0;
+};
+
+}
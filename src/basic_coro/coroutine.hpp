@@ -306,6 +306,25 @@ public:
         using _Allocator::overrides::operator new;
         using _Allocator::overrides::operator delete;
 
+        //allocator can wrap initial suspend (to run code when coroutine starts)
+        #ifdef BASIC_CORO_ENABLE_TRACE
+        auto initial_suspend(std::source_location loc = std::source_location::current()) noexcept {
+            return wrap_initial(coroutine<T, objstdalloc>::promise_type::initial_suspend(loc));
+        }
+        #else
+        auto initial_suspend() noexcept {
+            return wrap_initial(coroutine<T, objstdalloc>::promise_type::initial_suspend());
+        }
+        #endif
+
+    protected:
+        auto wrap_initial(std::suspend_always s) noexcept {
+            if constexpr(requires(typename _Allocator::overrides &o) {o.wrap_initial_suspend(s);}) {
+                return this->wrap_initial_suspend(s);
+            } else {
+                return s;
+            }
+        }
     };
     coroutine(promise_type *p):coroutine<T, objstdalloc>(p) {}
 };
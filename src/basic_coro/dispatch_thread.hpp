@@ -5,7 +5,7 @@
 #include "basic_coro/pending.hpp"
 #include "basic_coro/prepared_coro.hpp"
 #include "basic_coro/result_proxy.hpp"
-#include <condition_variable>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <stop_token>
@@ -22,22 +22,40 @@ namespace coro {
  To create new dispatch_thread, you need to create it with function create();
  The instance is managed by shared_ptr. It keeps instance alive while there
  is at least one reference, or when there are task in the queue. 
+
+ Enqueued tasks are stored in lock-free intrusive MPSC queue. The thread takes
+ all enqueued tasks at once and resumes them in order of enqueue. When the
+ queue is empty, the thread spins for a short while and then it is parked
+ (std::atomic::wait - futex on Linux)
+
+ Nodes of the queue are recycled. The thread returns nodes of finished batch
+ to a free list, producers take whole free list at once into a thread local cache,
+ so the steady state enqueue doesn't allocate
 */
 class dispatch_thread:  public std::enable_shared_from_this<dispatch_thread> {
 public:
 
     ///enqueue a coroutine for execution
+    /**
+     * The function is lock-free. The coroutine is pushed into an intrusive MPSC queue. The
+     * dispatcher thread is woken up only when it is parked
+     *
+     * @param coro coroutine to enqueue
+     */
     void enqueue(prepared_coro coro) {
-        bool empty = false;
-        {
-            std::scoped_lock _(_mx);
-            empty = _queue.empty();
-            if (empty) _instance_lock = shared_from_this();
-            _queue.push(std::move(coro));
+        node *n = alloc_node(coro.release());
+        //first pending task locks the instance
+        if (_pending.fetch_add(1, std::memory_order_relaxed) == 0) lock_instance();
+        node *top = _head.load(std::memory_order_relaxed);
+        do {
+            n->next = top;
+        } while (!_head.compare_exchange_weak(top, n, std::memory_order_seq_cst, std::memory_order_relaxed));
+        if (_parked.load(std::memory_order_seq_cst)) {
+            _parked.store(false, std::memory_order_relaxed);
+            _parked.notify_one();
         }
-        if (empty) _cv.notify_one();        
     }
-    
+
     ///Launch asynchronous operation in dispatcher thread
     /**
       This function is intended for coroutines, which are started in current thread. If you need
@@ -65,6 +83,9 @@ public:
         } else {
             _thr.join();
         }
+        //remaining tasks are resumed by this thread
+        run_batch(_head.exchange(nullptr, std::memory_order_acquire));
+        delete_nodes(_free.exchange(nullptr, std::memory_order_acquire));
         _join();
     }
 
@@ -109,14 +130,44 @@ public:
     }
 
 protected:
+
+    struct node {
+        node *next;
+        std::coroutine_handle<> h;
+    };
+
+    static void delete_nodes(node *n) {
+        while (n) {
+            node *x = n;
+            n = n->next;
+            delete x;
+        }
+    }
+
+    //free nodes owned by the producer thread
+    struct node_cache {
+        node *list = nullptr;
+        ~node_cache() {delete_nodes(list);}
+    };
+
+    ///count of iterations spent by checking the queue before the thread is parked
+    static constexpr unsigned int spin_count = 64;
+
     mutable std::mutex _mx;
     std::jthread _thr;
-    std::queue<prepared_coro> _queue;
-    std::condition_variable _cv;
+    //top of intrusive stack of enqueued tasks (producers push, worker takes all)
+    std::atomic<node *> _head = {nullptr};
+    //stack of free nodes (worker pushes finished batches, producers take all)
+    std::atomic<node *> _free = {nullptr};
+    //count of tasks enqueued and not yet finished
+    std::atomic<std::size_t> _pending = {0};
+    //worker is parked (or going to be parked) on this flag
+    std::atomic<bool> _parked = {false};
     std::shared_ptr<void> _instance_lock;
     awaitable_result<void> _join;
 
     static thread_local std::weak_ptr<dispatch_thread> cur_instance;
+    static thread_local node_cache free_nodes;
 
 
 
@@ -127,26 +178,83 @@ protected:
         });
     }
 
+    //called by producer on transition from idle to busy
+    void lock_instance() {
+        std::lock_guard _(_mx);
+        _instance_lock = shared_from_this();
+    }
+
+    //called by worker after the batch is finished. Returns the lock to be released outside of the mutex
+    std::shared_ptr<void> unlock_instance(std::size_t finished) {
+        if (_pending.fetch_sub(finished, std::memory_order_relaxed) != finished) return {};
+        std::lock_guard _(_mx);
+        //a producer could enqueue a new task meanwhile, keep the lock in that case
+        if (_pending.load(std::memory_order_relaxed)) return {};
+        return std::move(_instance_lock);
+    }
+
+    //takes node from thread's cache, refills the cache from the free list
+    node *alloc_node(std::coroutine_handle<> h) {
+        node_cache &cache = free_nodes;
+        //whole list is taken, so there is no ABA problem
+        if (!cache.list) cache.list = _free.exchange(nullptr, std::memory_order_acquire);
+        node *n = cache.list;
+        if (!n) return new node{nullptr, h};
+        cache.list = n->next;
+        n->h = h;
+        return n;
+    }
+
+    //resumes tasks taken from the queue in order of enqueue, returns count of tasks
+    std::size_t run_batch(node *lst) {
+        if (!lst) return 0;
+        node *fifo = nullptr;
+        node *last = lst;
+        std::size_t cnt = 0;
+        while (lst) {
+            node *n = lst;
+            lst = n->next;
+            n->next = fifo;
+            fifo = n;
+            ++cnt;
+        }
+        for (node *n = fifo; n; n = n->next) {
+            prepared_coro(std::exchange(n->h, {})).lazy_resume();
+        }
+        //return nodes to the free list
+        node *top = _free.load(std::memory_order_relaxed);
+        do {
+            last->next = top;
+        } while (!_free.compare_exchange_weak(top, fifo, std::memory_order_release, std::memory_order_relaxed));
+        return cnt;
+    }
+
+    //waits for tasks - spins for a while, then parks the thread
+    void wait_for_tasks(const std::stop_token &tkn) {
+        for (unsigned int i = 0; i < spin_count; ++i) {
+            if (_head.load(std::memory_order_relaxed) || tkn.stop_requested()) return;
+            std::this_thread::yield();
+        }
+        _parked.store(true, std::memory_order_seq_cst);
+        //producer either sees the flag, or we see its task
+        if (!_head.load(std::memory_order_seq_cst) && !tkn.stop_requested()) {
+            _parked.wait(true, std::memory_order_acquire);
+        }
+        _parked.store(false, std::memory_order_relaxed);
+    }
+
     void worker(std::stop_token tkn) {
         std::stop_callback stopper(tkn, [this]{
-            std::lock_guard _(_mx);
-            _cv.notify_one();
+            _parked.store(false, std::memory_order_seq_cst);
+            _parked.notify_one();
         });
         while (!tkn.stop_requested()) {
-            std::shared_ptr<void> ilock;
-            std::unique_lock lk(_mx);
-            if (_queue.empty()) {
-                if (tkn.stop_requested()) break;
-                _cv.wait(lk);
+            node *lst = _head.exchange(nullptr, std::memory_order_acquire);
+            if (lst) {
+                std::size_t cnt = run_batch(lst);
+                unlock_instance(cnt).reset();
             } else {
-                auto p = std::move(_queue.front());
-                _queue.pop();
-                if (_queue.empty()) {
-                    ilock = std::move(_instance_lock);               
-                }
-                lk.unlock();
-                p.lazy_resume();
-                ilock.reset();
+                wait_for_tasks(tkn);
             }
         }
     }
@@ -154,6 +262,7 @@ protected:
 };
 
 inline thread_local std::weak_ptr<dispatch_thread> dispatch_thread::cur_instance = {};
+inline thread_local dispatch_thread::node_cache dispatch_thread::free_nodes = {};
 
 class dispatch_proxy_callaback_type {
 public:
@@ -3,16 +3,37 @@
 #include "awaitable.hpp"
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include "cancel_signal.hpp"
+#include "coro_frame.hpp"
 #include "basic_lockable.hpp"
 
 namespace coro {
 
+///type of the value shared by listeners of distributor<std::shared_ptr<const V> > (void otherwise)
+template<typename T>
+struct distributor_shared_value {
+    using type = void;
+};
+
+template<typename V>
+struct distributor_shared_value<std::shared_ptr<const V> > {
+    using type = V;
+};
+
 
 template<typename T, basic_lockable Lock = empty_lockable>
 class distributor {
 public:
     using value_type = voidless_type<T>;
+    ///type of the value constructed by broadcast_shared() (void if not available)
+    using shared_type = typename distributor_shared_value<T>::type;
 
     using awaitable = coro::awaitable<T>;
     using result_object = typename awaitable::result;
@@ -39,6 +60,7 @@ public:
     prepared_coro add_listener(result_object r, cancel_signal *a) {
         lock_guard _(_mx);
         if (a && *a) return r.set_empty();
+        if (a) a->set_slot_hint(_results.size());
         _results.push_back({std::move(r), a});
         return {};
     }
@@ -57,9 +79,16 @@ public:
     void broadcast(prepared &buffer, Args && ... args) {
         lock_guard _(_mx);
         for (auto &r: _results) {
+            if (r.i) r.i->set_slot_hint(cancel_signal::no_slot);
             buffer.push_back(r.r(args...));
         }
         _results.clear();
+        if constexpr(!std::is_reference_v<T>) {
+            for (auto s = _subs; s; s = s->_next) {
+                if (s->_r) buffer.push_back(s->_r(args...));
+                else s->push_inbox(args...);
+            }
+        }
     }
 
     ///broadcast the value and resume awaiting coroutines in current thread
@@ -76,36 +105,435 @@ public:
         _ready_to_run.clear();
     }
 
+    ///broadcast the value constructed once, listeners share it
+    /**
+     * Available when T is std::shared_ptr<const V> (distributor<std::shared_ptr<const msg> >).
+     * The value is constructed once, every listener receives a pointer to the same
+     * object. Nothing is copied per listener. The value is released when the last listener
+     * drops its pointer, so it stays valid for listeners which are not coroutines
+     * (get(), wait(), sync_await) and for listeners which keep it across suspension
+     *
+     * @param buffer (preallocated) buffer to store prepared coroutines. You need to clear
+     * the buffer to resume listeners.
+     * @param args arguments need to construct value
+     *
+     * @note This function is MT-Safe if the Lock is std::mutex
+     */
+    template<typename ... Args>
+    requires(std::is_constructible_v<shared_type, Args...>)
+    void broadcast_shared(prepared &buffer, Args && ... args) {
+        broadcast(buffer, std::make_shared<const shared_type>(std::forward<Args>(args)...));
+    }
+
+    ///broadcast the value constructed once and resume listeners in current thread
+    /**
+     * @see broadcast_shared(prepared &, Args && ...)
+     * @note only one thread can call this function at the same time
+     */
+    template<typename ... Args>
+    requires(std::is_constructible_v<shared_type, Args...>)
+    void broadcast_shared(Args && ... args) {
+        broadcast_shared(_ready_to_run, std::forward<Args>(args)...);
+        _ready_to_run.clear();
+    }
+
+    ///broadcast the value and resume listeners in parallel on an executor
+    /**
+     * Listeners are split into chunks. Each chunk is submitted to the executor as one task,
+     * which resumes listeners of the chunk serially.
+     *
+     * @param executor executor (thread_pool, thread_pool::executor_type, or any
+     * function which accepts prepared_coro)
+     * @param chunk_size max count of listeners per task
+     * @param args arguments need to construct value. If T is std::shared_ptr<const V> and
+     * the arguments construct V, the value is constructed once (see broadcast_shared()),
+     * otherwise it is constructed per listener
+     * @return awaitable which is resolved when every listener has run up to its next
+     * suspension point. You don't need to co_await it
+     *
+     * @note This function is MT-Safe if the Lock is std::mutex
+     */
+    template<scheduler_executor Executor, typename ... Args>
+    requires(!std::is_reference_v<T> && (std::is_constructible_v<value_type, Args...> || std::is_constructible_v<shared_type, Args...>))
+    coro::awaitable<void> broadcast_on(Executor &&executor, std::size_t chunk_size, Args && ... args) {
+        auto job = prepare_job(chunk_size, std::forward<Args>(args)...);
+        if (!job) return {};
+        std::vector<prepared_coro> tasks;
+        tasks.reserve(job->_chunk_count);
+        for (std::size_t i = 0; i < job->_chunk_count; ++i) tasks.push_back(job->_chunks[i].create_handle());
+        execute_batch(executor, std::span<prepared_coro>(tasks));
+        return join_cb(job);
+    }
+
+    ///broadcast the value and resume listeners in parallel on a set of executors
+    /**
+     * Chunks are distributed over executors round-robin (for example one executor
+     * per dispatch_thread)
+     *
+     * @param executors executors (must not be empty)
+     * @param chunk_size max count of listeners per task
+     * @param args arguments need to construct value
+     * @return awaitable which is resolved when every listener has run up to its next
+     * suspension point
+     * @exception std::invalid_argument executors is empty, listeners are not removed
+     */
+    template<scheduler_executor Executor, typename ... Args>
+    requires(!std::is_reference_v<T> && (std::is_constructible_v<value_type, Args...> || std::is_constructible_v<shared_type, Args...>))
+    coro::awaitable<void> broadcast_on(std::span<Executor> executors, std::size_t chunk_size, Args && ... args) {
+        if (executors.empty()) throw std::invalid_argument("broadcast_on: no executor");
+        auto job = prepare_job(chunk_size, std::forward<Args>(args)...);
+        if (!job) return {};
+        for (std::size_t i = 0; i < job->_chunk_count; ++i) {
+            prepared_coro task(job->_chunks[i].create_handle());
+            execute_batch(executors[i % executors.size()], std::span<prepared_coro>(&task, 1));
+        }
+        return join_cb(job);
+    }
+
+    ///cancel waiting listener
+    /**
+     * @param cancel_signal identification of the listener. The signal is set
+     * @return prepared coroutine of the listener, which receives no value (await_canceled_exception)
+     *
+     * @note The position of the listener is stored in the signal during registration, so
+     * the operation is O(1). The signal must not identify multiple listeners at the same time
+     */
     prepared_coro cancel(cancel_signal *cancel_signal) {
         prepared_coro out;
         lock_guard _(_mx);
         cancel_signal->request_cancel();
-        auto iter = std::find_if(_results.begin(), _results.end(), [&](const awaiting_info &x){
-            return x.i == cancel_signal;
-        });
-        if (iter != _results.end()) {
-            out = (iter->r = std::nullopt);
-
-            auto last = _results.end();
-            --last;
-            if (iter != last) std::swap(*iter, *last);
-            _results.pop_back();
+        std::size_t idx = cancel_signal->get_slot_hint();
+        if (idx == coro::cancel_signal::no_slot) return out;
+        if (idx >= _results.size() || _results[idx].i != cancel_signal) {
+            auto iter = std::find_if(_results.begin(), _results.end(), [&](const awaiting_info &x){
+                return x.i == cancel_signal;
+            });
+            if (iter == _results.end()) return out;
+            idx = static_cast<std::size_t>(iter - _results.begin());
         }
+        cancel_signal->set_slot_hint(coro::cancel_signal::no_slot);
+        out = (_results[idx].r = std::nullopt);
+        if (idx != _results.size() - 1) {
+            _results[idx] = std::move(_results.back());
+            if (_results[idx].i) _results[idx].i->set_slot_hint(idx);
+        }
+        _results.pop_back();
         return out;
-
     }
 
     bool empty() const {
         lock_guard _(_mx);
-        return _results.empty();
+        return _results.empty() && !_subs;
     }
 
+    ///persistent subscription
+    /**
+     * The subscription is registered once and receives every value broadcasted during its
+     * lifetime. Values which arrive while the subscriber is not awaiting are stored in
+     * its inbox, so no value is missed between resumption and next co_await.
+     *
+     * @code
+     * coro::distributor<int>::subscription sub(dist);
+     * while (true) {
+     *      int v = co_await sub.next();
+     *      process(v);
+     * }
+     * @endcode
+     *
+     * The inbox is a ring buffer, which grows when it is full, so the broadcast never
+     * blocks and never drops a value. In steady state the broadcast doesn't allocate.
+     * Subscribers are linked in an intrusive list.
+     *
+     * @note the object must not be moved. It is not available for references (T is
+     * a reference)
+     */
+    class subscription {
+    public:
+
+        ///subscribe
+        /**
+         * @param dist distributor
+         * @param inbox initial capacity of the inbox (rounded up to power of two)
+         */
+        explicit subscription(distributor &dist, std::size_t inbox = 4)
+        requires(!std::is_reference_v<T>)
+            :_dist(&dist),_mask(std::bit_ceil(std::max<std::size_t>(inbox, 1)) - 1)
+            ,_inbox(std::make_unique<std::optional<stored_type>[]>(_mask + 1)) {
+            lock_guard _(_dist->_mx);
+            _next = _dist->_subs;
+            if (_next) _next->_prev = this;
+            _dist->_subs = this;
+        }
+
+        subscription(const subscription &) = delete;
+        subscription &operator=(const subscription &) = delete;
+
+        ///unsubscribe, pending next() is resolved without value
+        ~subscription() {
+            result_object r;
+            lock_guard _(_dist->_mx);
+            if (_prev) _prev->_next = _next; else _dist->_subs = _next;
+            if (_next) _next->_prev = _prev;
+            r = std::move(_r);
+        }
+
+        ///receive next value
+        /**
+         * @return awaitable value. If there is a value in the inbox, the awaitable is
+         * resolved immediately
+         *
+         * @note you need co_await on result, otherwise the value is lost
+         */
+        awaitable next() requires(!std::is_reference_v<T>) {
+            lock_guard _(_dist->_mx);
+            if (_front != _back) return pop_inbox();
+            return [this](result_object r) -> prepared_coro {
+                if (!r) return {};
+                lock_guard _(_dist->_mx);
+                if (_front != _back) return r(pop_inbox());
+                _r = std::move(r);
+                return {};
+            };
+        }
+
+        ///retrieve count of values in the inbox
+        std::size_t pending() const {
+            lock_guard _(_dist->_mx);
+            return _front - _back;
+        }
+
+    protected:
+        friend class distributor;
+
+        using stored_type = std::remove_cvref_t<value_type>;
+
+        distributor *_dist;
+        subscription *_next = nullptr;
+        subscription *_prev = nullptr;
+        result_object _r;
+        std::size_t _mask;
+        std::unique_ptr<std::optional<stored_type>[]> _inbox;
+        std::size_t _front = 0;
+        std::size_t _back = 0;
+
+        template<typename ... Args>
+        void push_inbox(Args && ... args) {
+            if (_front - _back > _mask) grow();
+            _inbox[_front & _mask].emplace(std::forward<Args>(args)...);
+            ++_front;
+        }
+
+        stored_type pop_inbox() {
+            auto &slot = _inbox[_back++ & _mask];
+            stored_type v = std::move(*slot);
+            slot.reset();
+            return v;
+        }
+
+        void grow() {
+            std::size_t cap = (_mask + 1) * 2;
+            auto n = std::make_unique<std::optional<stored_type>[]>(cap);
+            for (std::size_t i = _back; i != _front; ++i) n[i - _back] = std::move(_inbox[i & _mask]);
+            _front -= _back;
+            _back = 0;
+            _inbox = std::move(n);
+            _mask = cap - 1;
+        }
+    };
+
 protected:
+
+    struct broadcast_job;
+
+    //resumes a chunk of listeners of broadcast_on()
+    struct chunk_frame: coro_frame<chunk_frame> {
+        broadcast_job *_job = nullptr;
+        std::size_t _begin = 0;
+        std::size_t _end = 0;
+
+        prepared_coro do_resume() {
+            for (std::size_t i = _begin; i < _end; ++i) _job->_coros[i].resume();
+            return _job->release();
+        }
+        void do_destroy() {
+            for (std::size_t i = _begin; i < _end; ++i) _job->_coros[i].destroy();
+            _job->release();
+        }
+    };
+
+    //state of broadcast_on(), released by the last chunk and the join awaitable
+    struct broadcast_job {
+        std::vector<prepared_coro> _coros;
+        std::size_t _chunk_count;
+        std::unique_ptr<chunk_frame[]> _chunks;
+        std::atomic<std::size_t> _refs;
+        coro::awaitable<void>::result _join;
+
+        broadcast_job(std::vector<prepared_coro> coros, std::size_t chunk_size)
+            :_coros(std::move(coros))
+            ,_chunk_count((_coros.size() + chunk_size - 1) / chunk_size)
+            ,_chunks(std::make_unique<chunk_frame[]>(_chunk_count))
+            ,_refs(_chunk_count + 1) {
+            for (std::size_t i = 0; i < _chunk_count; ++i) {
+                auto &c = _chunks[i];
+                c._job = this;
+                c._begin = i * chunk_size;
+                c._end = std::min(c._begin + chunk_size, _coros.size());
+            }
+        }
+
+        prepared_coro release() {
+            if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return {};
+            auto r = std::move(_join);
+            delete this;
+            return r();
+        }
+    };
+
+    //join awaitable of broadcast_on(), releases the job when it is dropped
+    struct join_cb {
+        broadcast_job *_job;
+        explicit join_cb(broadcast_job *job):_job(job) {}
+        join_cb(join_cb &&other):_job(std::exchange(other._job, nullptr)) {}
+        ~join_cb() {if (_job) _job->release();}
+        prepared_coro operator()(coro::awaitable<void>::result r) {
+            auto job = std::exchange(_job, nullptr);
+            job->_join = std::move(r);
+            return job->release();
+        }
+    };
+
+    template<typename ... Args>
+    broadcast_job *prepare_job(std::size_t chunk_size, Args && ... args) {
+        prepared buffer;
+        if constexpr(std::is_constructible_v<value_type, Args...>) {
+            broadcast(buffer, std::forward<Args>(args)...);
+        } else {
+            broadcast_shared(buffer, std::forward<Args>(args)...);
+        }
+        std::erase_if(buffer, [](const prepared_coro &c){return !c;});
+        if (buffer.empty()) return nullptr;
+        return new broadcast_job(std::move(buffer), std::max<std::size_t>(chunk_size, 1));
+    }
+
     mutable Lock _mx;
     std::vector<awaiting_info> _results;
+    subscription *_subs = nullptr;
     std::vector<prepared_coro> _ready_to_run;
 
 };
 
 
+///distributor which spreads listeners over multiple shards
+/**
+ * Each shard is a distributor with its own lock and executor. Listeners with
+ * identification are assigned to a shard by the identification, so cancel()
+ * locks only one shard. Anonymous listeners are assigned round-robin.
+ *
+ * The broadcast walks shards and passes listeners of each shard to the executor of the
+ * shard (in one batch, if the executor supports batches).
+ *
+ * @code
+ * coro::thread_pool pool(4);
+ * coro::sharded_distributor<int, std::mutex, coro::thread_pool::executor_type> dist(
+ *          {pool.get_executor(), pool.get_executor(), pool.get_executor(), pool.get_executor()});
+ * @endcode
+ *
+ * @tparam T type of value (see distributor)
+ * @tparam Lock lock of each shard
+ * @tparam Executor executor of each shard (default inline_executor resumes listeners in
+ * the thread, which calls broadcast())
+ */
+template<typename T, basic_lockable Lock = empty_lockable, scheduler_executor Executor = inline_executor>
+class sharded_distributor {
+public:
+    using distributor_type = distributor<T, Lock>;
+    using awaitable = typename distributor_type::awaitable;
+    using value_type = typename distributor_type::value_type;
+    using ident = typename distributor_type::ident;
+
+    ///construct with default constructed executors
+    /**
+     * @param shards count of shards (at least 1)
+     */
+    explicit sharded_distributor(std::size_t shards) requires(std::is_default_constructible_v<Executor>) {
+        shards = std::max<std::size_t>(shards, 1);
+        _shards.reserve(shards);
+        for (std::size_t i = 0; i < shards; ++i) _shards.push_back(std::make_unique<shard>(Executor{}));
+    }
+
+    ///construct with executors, one shard per executor
+    /**
+     * @param executors executors, count of executors defines count of shards (must not be empty)
+     */
+    explicit sharded_distributor(std::vector<Executor> executors) {
+        _shards.reserve(executors.size());
+        if (executors.empty()) throw std::invalid_argument("sharded_distributor: no executor");
+        for (auto &e: executors) _shards.push_back(std::make_unique<shard>(std::move(e)));
+    }
+
+    ///register coroutine to receive broadcast
+    /**
+     * @param id identification (optional), it selects the shard
+     * @return awaitable
+     * @note MT-Safe if the Lock is std::mutex
+     */
+    awaitable operator()(ident id = {}) {
+        return select_shard(id).dist(id);
+    }
+
+    ///broadcast the value
+    /**
+     * @param args arguments need to construct value (constructed per listener)
+     * @note only one thread can call broadcast() at the same time
+     */
+    template<typename ... Args>
+    requires(std::is_constructible_v<value_type, Args...>)
+    void broadcast(Args && ... args) {
+        for (auto &s: _shards) {
+            s->dist.broadcast(s->buffer, args...);
+            execute_batch(s->exec, std::span<prepared_coro>(s->buffer));
+            s->buffer.clear();
+        }
+    }
+
+    ///cancel waiting listener
+    /**
+     * @param id identification of the listener
+     * @return prepared coroutine of canceled listener
+     */
+    prepared_coro cancel(ident id) {
+        return select_shard(id).dist.cancel(id);
+    }
+
+    ///retrieve count of shards
+    std::size_t shard_count() const {return _shards.size();}
+
+    ///determine whether there are no listeners
+    bool empty() const {
+        for (auto &s: _shards) if (!s->dist.empty()) return false;
+        return true;
+    }
+
+protected:
+
+    struct alignas(64) shard {
+        distributor_type dist;
+        Executor exec;
+        std::vector<prepared_coro> buffer;
+        explicit shard(Executor e):exec(std::move(e)) {}
+    };
+
+    std::vector<std::unique_ptr<shard> > _shards;
+    std::atomic<std::size_t> _next = {};
+
+    shard &select_shard(ident id) {
+        std::size_t n;
+        if (id) n = static_cast<std::size_t>(reinterpret_cast<std::uintptr_t>(id) / sizeof(cancel_signal));
+        else n = _next.fetch_add(1, std::memory_order_relaxed);
+        return *_shards[n % _shards.size()];
+    }
+};
+
+
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <memory_resource>
 #include "allocator.hpp"
 
@@ -169,4 +170,217 @@ public:
     }
 };
 
+/** segmented_stack_memory_resource is a growable variant of the flat_stack_memory_resource.
+ *
+ * The memory is organized as a chain of segments. Allocations are taken from the top of the
+ * current segment the same way as in flat_stack_memory_resource. When the current segment is
+ * full, the next segment is taken from the chain or allocated from the upstream memory
+ * resource (instead of throwing std::bad_alloc). When the current segment becomes empty
+ * during unwinding, the previous segment becomes current again.
+ *
+ * Empty segments are not returned to the upstream immediately. The resource keeps
+ * up to spare_segments empty segments above the current segment, so the stack oscillating
+ * around the segment boundary doesn't allocate and release the segment repeatedly. Only
+ * surplus segments are returned to the upstream resource.
+ *
+ * - allocation is O(1) (amortized, new segment is allocated only on overflow)
+ * - deallocation of the top is O(1). Deallocation of a block in a segment below the
+ *   current segment needs to walk the chain to find the segment
+ *
+ * A single allocation larger than segment size is placed into a dedicated segment
+ * of sufficient size.
+ */
+class segmented_stack_memory_resource_extendable: public std::pmr::memory_resource {
+public:
+
+    static constexpr std::size_t block_size = sizeof(std::size_t);
+
+    static constexpr std::size_t to_blocks(std::size_t bytes) {
+        return (bytes+block_size-1)/block_size;
+    }
+
+    /// construct object
+    /**
+     * @param segment_size size of one segment in bytes
+     * @param spare_segments count of empty segments kept for reuse (hysteresis)
+     * @param res upstream memory resource used to allocate segments
+     */
+    segmented_stack_memory_resource_extendable(std::size_t segment_size, std::size_t spare_segments, std::pmr::memory_resource *res)
+        :_mres(res),_segment_blocks(to_blocks(segment_size)),_spare_segments(spare_segments) {
+        _current = alloc_segment(_segment_blocks);
+    }
+
+    /// construct object
+    /**
+     * @param segment_size size of one segment in bytes
+     * @param spare_segments count of empty segments kept for reuse (hysteresis)
+     */
+    explicit segmented_stack_memory_resource_extendable(std::size_t segment_size, std::size_t spare_segments = 1)
+        :segmented_stack_memory_resource_extendable(segment_size, spare_segments, std::pmr::get_default_resource()) {}
+
+    ~segmented_stack_memory_resource_extendable() {
+        segment *s = _current;
+        while (s->prev) s = s->prev;
+        while (s) {
+            segment *n = s->next;
+            free_segment(s);
+            s = n;
+        }
+    }
+
+    segmented_stack_memory_resource_extendable(const segmented_stack_memory_resource_extendable &) = delete;
+    segmented_stack_memory_resource_extendable &operator=(const segmented_stack_memory_resource_extendable &) = delete;
+
+    ///retrieve count of allocated segments (including spare segments)
+    std::size_t get_segment_count() const {
+        std::size_t cnt = 0;
+        const segment *s = _current;
+        while (s->prev) s = s->prev;
+        for (;s;s = s->next) ++cnt;
+        return cnt;
+    }
+
+protected:
+
+    struct segment {
+        //previous segment in chain (lower in stack)
+        segment *prev;
+        //next segment in chain (spare segment)
+        segment *next;
+        //count of blocks in this segment
+        std::size_t count;
+        //top of the stack in this segment
+        std::size_t top;
+
+        std::size_t *mem() {return reinterpret_cast<std::size_t *>(this+1);}
+        bool contains(const void *p) {
+            auto b = reinterpret_cast<const char *>(mem());
+            auto c = reinterpret_cast<const char *>(p);
+            return c >= b && c < b + count * block_size;
+        }
+    };
+
+    static_assert(sizeof(segment) % block_size == 0);
+
+    segment *alloc_segment(std::size_t blocks) {
+        void *ptr = _mres->allocate(sizeof(segment)+blocks*block_size);
+        return new(ptr) segment{nullptr, nullptr, blocks, 0};
+    }
+
+    void free_segment(segment *s) {
+        _mres->deallocate(s, sizeof(segment)+s->count*block_size);
+    }
+
+    virtual void* do_allocate(size_t bytes, size_t alignment) {
+        std::size_t align_in_blocks = to_blocks(alignment);
+        std::size_t needsz = 0;
+        std::size_t aextra = 0;
+        auto calc_need = [&](const segment *s) {
+            aextra = (align_in_blocks - (s->top % align_in_blocks)) % align_in_blocks;
+            needsz = to_blocks(bytes)+aextra+1;
+            return s->top + needsz <= s->count;
+        };
+        if (!calc_need(_current)) {
+            segment *n = _current->next;
+            if (n) {
+                if (!calc_need(n)) {
+                    _current->next = n->next;
+                    if (n->next) n->next->prev = _current;
+                    free_segment(n);
+                    n = nullptr;
+                }
+            }
+            if (!n) {
+                std::size_t reqsz = to_blocks(bytes)+align_in_blocks+1;
+                n = alloc_segment(std::max(_segment_blocks, reqsz));
+                n->prev = _current;
+                n->next = _current->next;
+                if (n->next) n->next->prev = n;
+                _current->next = n;
+                calc_need(n);
+            }
+            _current = n;
+        }
+        std::size_t *mem = _current->mem();
+        auto curtop = _current->top;
+        void *r = mem+curtop+aextra;
+        std::size_t *m = mem+curtop+needsz-1;
+        *m = needsz << 1;
+        _current->top += needsz;
+        return r;
+    }
+
+    virtual void do_deallocate(void* p, size_t bytes, size_t ) {
+        segment *s = _current;
+        while (!s->contains(p)) s = s->prev;
+        std::size_t *mem = s->mem();
+        std::size_t pos = to_blocks(reinterpret_cast<char *>(p) - reinterpret_cast<char *>(mem));
+        std::size_t sep = pos + to_blocks(bytes);
+        mem[sep] |= 1;
+        if (s == _current) {
+            cleanup(s);
+            if (s->top == 0 && s->prev) {
+                while (_current->top == 0 && _current->prev) {
+                    _current = _current->prev;
+                    cleanup(_current);
+                }
+                release_spares();
+            }
+        }
+    }
+
+    static void cleanup(segment *s) {
+        std::size_t *mem = s->mem();
+        while (s->top > 0) {
+            std::size_t sep = mem[s->top-1];
+            std::size_t sz = sep >> 1;
+            if (sep & 0x1) {
+                s->top -= sz;
+            } else {
+                break;
+            }
+        }
+    }
+
+    //returns segments above the spare limit to the upstream
+    void release_spares() {
+        segment *s = _current;
+        for (std::size_t i = 0; i < _spare_segments && s->next; ++i) s = s->next;
+        segment *n = s->next;
+        s->next = nullptr;
+        while (n) {
+            segment *x = n;
+            n = n->next;
+            free_segment(x);
+        }
+    }
+
+    virtual bool do_is_equal(const memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource *_mres = nullptr;
+    segment *_current = nullptr;
+    std::size_t _segment_blocks = 0;
+    std::size_t _spare_segments = 0;
+};
+
+///final version of segmented_stack_memory_resource_extendable
+/**
+ * @see segmented_stack_memory_resource_extendable
+ * @note this class is final, which helps to pmr_allocator to avoid usage of virtual functions.
+ */
+class segmented_stack_memory_resource final: public segmented_stack_memory_resource_extendable {
+public:
+    using segmented_stack_memory_resource_extendable::segmented_stack_memory_resource_extendable;
+
+    void* allocate(size_t __bytes, size_t __alignment  = alignof(std::max_align_t)){
+        return segmented_stack_memory_resource_extendable::do_allocate(__bytes, __alignment);
+    }
+
+    void deallocate(void* __p, size_t __bytes, size_t __alignment = alignof(std::max_align_t))  {
+        return segmented_stack_memory_resource_extendable::do_deallocate(__p, __bytes, __alignment);
+    }
+};
+
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "awaitable.hpp"
+#include "coro_frame.hpp"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace coro {
+
+///tracks live bytes of coroutine frames of a group and provides admission control
+/**
+ * Coroutines of the group are declared with budget_allocator. Every allocated frame
+ * is accounted to the budget. Allocation itself never blocks (a frame cannot wait
+ * for memory), however new work should be started after it passes admit() gate.
+ *
+ * @code
+ * memory_budget budget(64*1024*1024, pool.get_executor());
+ *
+ * coroutine<void, budget_allocator<> > worker(budget_allocator<>, request req);
+ *
+ * coroutine<void> producer(queue<request> &q) {
+ *      while (true) {
+ *          auto req = co_await q.pop();
+ *          co_await budget.admit();     //suspends while budget is exceeded
+ *          worker(budget, std::move(req));   //start detached
+ *      }
+ * }
+ * @endcode
+ *
+ * The gate suspends callers once live bytes reach the budget. Waiting callers are
+ * admitted in FIFO order, one by one, while the usage is below the budget. The next caller
+ * is admitted after the previous one is suspended again (so it had chance to start
+ * its work and allocate its frames), so the overshoot is limited to footprint of one
+ * admitted work.
+ *
+ * Admitted callers are resumed through the executor. The admission is triggered
+ * inside of allocation and deallocation of frames, where the coroutine can't be resumed
+ * directly
+ *
+ * @note MT-Safe
+ */
+class memory_budget {
+public:
+
+    ///construct budget
+    /**
+     * @param budget maximum count of live bytes before the admission is blocked
+     * @param executor executor which resumes admitted callers (for example thread_pool::executor_type)
+     */
+    template<std::invocable<prepared_coro> Executor>
+    memory_budget(std::size_t budget, Executor executor)
+        :_budget(budget),_executor(std::move(executor)) {}
+
+    memory_budget(const memory_budget &) = delete;
+    memory_budget &operator=(const memory_budget &) = delete;
+
+    ///admission gate
+    /**
+     * @return awaitable which is resolved once the usage is below the budget. If
+     * the usage is below the budget and nobody is waiting, the awaitable is resolved
+     * immediately
+     */
+    awaitable<void> admit() {
+        if (can_admit_fast()) return {};
+        return admit_cb(this);
+    }
+
+    ///account allocated bytes
+    void on_allocate(std::size_t sz) {
+        _live.fetch_add(sz);
+    }
+
+    ///account released bytes
+    void on_deallocate(std::size_t sz) {
+        _live.fetch_sub(sz);
+        //pairs with admit_cb, which increments _waiting before it checks the budget
+        if (_waiting.load()) admit_next();
+    }
+
+    ///retrieve count of live bytes
+    std::size_t get_live_bytes() const {return _live.load(std::memory_order_relaxed);}
+    ///retrieve budget
+    std::size_t get_budget() const {return _budget.load(std::memory_order_relaxed);}
+    ///retrieve count of waiting callers (including the caller being admitted)
+    std::size_t get_waiting() const {return _waiting.load(std::memory_order_relaxed);}
+
+    ///change budget
+    /**
+     * @param budget new budget. If the budget is increased, waiting callers can be admitted
+     */
+    void set_budget(std::size_t budget) {
+        _budget.store(budget);
+        if (_waiting.load()) admit_next();
+    }
+
+protected:
+
+    //waiting caller, it is also frame which resumes the caller and admits the next one
+    struct slot: coro_frame<slot> {
+        memory_budget *me;
+        slot *next = nullptr;
+        awaitable<void>::result r;
+
+        slot(memory_budget *me):me(me) {}
+
+        void do_resume() {
+            memory_budget *m = me;
+            //admitted coroutine runs until it is suspended
+            r().resume();
+            m->admitted();
+        }
+        void do_destroy() {
+            memory_budget *m = me;
+            r = std::nullopt;
+            m->admitted();
+        }
+    };
+
+    struct admit_cb: slot {
+        using slot::slot;
+        prepared_coro operator()(awaitable<void>::result r) {
+            if (!r) return {};
+            memory_budget *m = this->me;
+            {
+                std::lock_guard _(m->_mx);
+                if (!m->_waiting.load() && m->under_budget()) return r();
+                this->r = std::move(r);
+                if (m->_last) m->_last->next = this; else m->_first = this;
+                m->_last = this;
+                m->_waiting.fetch_add(1);
+            }
+            //frame could be released before the waiter was counted
+            if (m->under_budget()) m->admit_next();
+            return {};
+        }
+    };
+
+    std::atomic<std::size_t> _budget;
+    std::atomic<std::size_t> _live = {0};
+    //count of waiting callers including the caller in flight
+    std::atomic<std::size_t> _waiting = {0};
+    std::function<void(prepared_coro)> _executor;
+    std::mutex _mx;
+    slot *_first = nullptr;
+    slot *_last = nullptr;
+    //a caller has been passed to the executor and it is not suspended yet
+    bool _in_flight = false;
+
+    bool under_budget() const {
+        return _live.load() < _budget.load();
+    }
+
+    bool can_admit_fast() const {
+        return !_waiting.load(std::memory_order_relaxed) && under_budget();
+    }
+
+    //passes first waiting caller to the executor, if usage is below the budget
+    void admit_next() {
+        slot *s;
+        {
+            std::lock_guard _(_mx);
+            if (_in_flight || !_first || !under_budget()) return;
+            s = _first;
+            _first = s->next;
+            if (!_first) _last = nullptr;
+            _in_flight = true;
+        }
+        _executor(prepared_coro(s->create_handle()));
+    }
+
+    //admitted caller has been resumed and suspended again
+    void admitted() {
+        {
+            std::lock_guard _(_mx);
+            _in_flight = false;
+            _waiting.fetch_sub(1);
+        }
+        admit_next();
+    }
+};
+
+///allocator which accounts allocated frames to memory_budget
+/**
+ * @tparam Base underlying allocator, which performs actual allocation (objstdalloc,
+ * pmr_allocator, etc). If the Base requires an argument, it must be also passed to the
+ * coroutine
+ *
+ * The instance of budget_allocator must be passed as an argument of the coroutine. It
+ * is implicitly constructible from memory_budget reference
+ *
+ * @code
+ * coroutine<int, budget_allocator<> > work(budget_allocator<>, int x);
+ *
+ * memory_budget budget(1024*1024);
+ * co_await budget.admit();
+ * int r = co_await work(budget, 42);
+ * @endcode
+ */
+template<coro_allocator Base = objstdalloc>
+class budget_allocator {
+public:
+
+    budget_allocator(memory_budget &budget):_budget(&budget) {}
+
+    struct overrides {
+        template<typename ... Args>
+        requires((std::is_same_v<budget_allocator, std::decay_t<Args> > ||...))
+        void *operator new(std::size_t sz, Args && ... args) {
+            budget_allocator *me = get_first_arg_of_type<budget_allocator>(args...);
+            std::size_t total = total_size(sz);
+            void *ptr = Base::overrides::operator new(total, args...);
+            *reinterpret_cast<memory_budget **>(ptr_plus_bytes(ptr, trailer_offset(sz))) = me->_budget;
+            me->_budget->on_allocate(total);
+            return ptr;
+        }
+        void operator delete(void *ptr, std::size_t sz) {
+            memory_budget *b = *reinterpret_cast<memory_budget **>(ptr_plus_bytes(ptr, trailer_offset(sz)));
+            std::size_t total = total_size(sz);
+            Base::overrides::operator delete(ptr, total);
+            b->on_deallocate(total);
+        }
+    };
+
+protected:
+    memory_budget *_budget;
+
+    static constexpr std::ptrdiff_t trailer_offset(std::size_t sz) {
+        return static_cast<std::ptrdiff_t>((sz + alignof(memory_budget *) - 1) & ~(alignof(memory_budget *) - 1));
+    }
+    static constexpr std::size_t total_size(std::size_t sz) {
+        return static_cast<std::size_t>(trailer_offset(sz)) + sizeof(memory_budget *);
+    }
+};
+
+static_assert(coro_allocator<budget_allocator<> >);
+
+}
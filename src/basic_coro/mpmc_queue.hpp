@@ -0,0 +1,642 @@
+#pragma once
+
+#include "queue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace coro {
+
+///Queue_Impl which can be accessed by multiple threads without a lock
+/**
+ * The basic_queue is specialized for such Queue_Impl. Push and pop doesn't
+ * take the lock unless the queue is empty or full. The lock is only used to
+ * manage lists of waiting coroutines
+ *
+ * try_push() must move the value only when it succeeds. A position is claimed by
+ * a seq_cst operation. is_empty() and is_full() read positions with seq_cst and
+ * they count claimed positions, even if the item is not yet written or removed. The
+ * queue uses it to detect an operation in progress, instead of a fence on the fast path
+ */
+template<typename T>
+concept lockfree_queue_impl = requires(T q, typename T::value_type v) {
+    {q.try_push(std::move(v))} -> std::same_as<bool>;
+    {q.try_pop()} -> std::same_as<std::optional<typename T::value_type> >;
+    {q.is_empty()} -> std::same_as<bool>;
+    {q.is_full()} -> std::same_as<bool>;
+};
+
+///bounded multi-producer multi-consumer ring (Vyukov)
+/**
+ * Each cell carries a sequence number, which tells to producers and consumers
+ * whether the cell is free or occupied for given position. Producers and consumers
+ * claim positions by CAS on separate cache lines.
+ *
+ * @tparam T type of item
+ * @tparam count capacity of the ring. Power of two is recommended
+ */
+template<typename T, unsigned int count>
+class mpmc_ring {
+public:
+
+    static_assert(count > 0, "mpmc_ring requires non-zero capacity");
+
+    using value_type = T;
+
+    mpmc_ring() {
+        for (unsigned int i = 0; i < count; ++i) _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    mpmc_ring(const mpmc_ring &) = delete;
+    mpmc_ring &operator=(const mpmc_ring &) = delete;
+
+    ~mpmc_ring() {
+        while (try_pop());
+    }
+
+    ///try to push item
+    /**
+     * @param val value to push. It is moved only if the function succeeds
+     * @retval true pushed
+     * @retval false queue is full
+     */
+    bool try_push(T &&val) {
+        return try_push_impl(std::move(val));
+    }
+
+    ///try to push item
+    bool try_push(const T &val) {
+        return try_push_impl(val);
+    }
+
+    ///try to pop item
+    /**
+     * @return item or nullopt if the queue is empty
+     */
+    std::optional<T> try_pop() {
+        std::size_t pos = _pop_pos.load(std::memory_order_relaxed);
+        cell *c;
+        while (true) {
+            c = &_cells[index(pos)];
+            std::size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (_pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return std::nullopt;
+            } else {
+                pos = _pop_pos.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> r(std::move(c->val));
+        std::destroy_at(&c->val);
+        c->seq.store(pos + count, std::memory_order_release);
+        return r;
+    }
+
+    ///determine whether queue is empty (including claimed positions)
+    bool is_empty() const {
+        return _push_pos.load(std::memory_order_seq_cst) == _pop_pos.load(std::memory_order_seq_cst);
+    }
+
+    ///determine whether queue is full (including claimed positions)
+    bool is_full() const {
+        std::size_t pop_pos = _pop_pos.load(std::memory_order_seq_cst);
+        return _push_pos.load(std::memory_order_seq_cst) - pop_pos >= count;
+    }
+
+protected:
+
+    struct cell {
+        std::atomic<std::size_t> seq;
+        union {
+            T val;
+        };
+        cell() {}
+        ~cell() {}
+    };
+
+    static constexpr std::size_t index(std::size_t pos) {
+        if constexpr(std::has_single_bit(count)) return pos & (count - 1);
+        else return pos % count;
+    }
+
+    template<typename X>
+    bool try_push_impl(X &&val) {
+        std::size_t pos = _push_pos.load(std::memory_order_relaxed);
+        cell *c;
+        while (true) {
+            c = &_cells[index(pos)];
+            std::size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _push_pos.load(std::memory_order_relaxed);
+            }
+        }
+        std::construct_at(&c->val, std::forward<X>(val));
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    alignas(64) std::atomic<std::size_t> _push_pos = {0};
+    alignas(64) std::atomic<std::size_t> _pop_pos = {0};
+    alignas(64) cell _cells[count];
+};
+
+
+///basic_queue specialization for lock-free Queue_Impl
+/**
+ * Push and pop operations are performed without lock while queue is neither empty nor
+ * full. The Lock only protects lists of suspended producers and consumers. Waiting
+ * coroutines are announced through atomic counters, so the fast path only checks
+ * these counters.
+ *
+ * @note a consumer on the fast path can overtake a suspended consumer, so FIFO order
+ * of waiting coroutines is not strict
+ *
+ * @note cases of select() and timed operations are supported. A waiter is claimed when
+ * an item (or a space) is available for it. If the fast path takes it first, the claimed
+ * waiter keeps waiting for the next one and its timeout no longer applies
+ *
+ * @note instrumentation (Stats) is not available for lock-free queues
+ */
+template<lockfree_queue_impl Queue_Impl, basic_lockable Lock>
+class basic_queue<Queue_Impl, Lock, no_queue_stats>
+    : public basic_queue_waiters<basic_queue<Queue_Impl, Lock, no_queue_stats>, typename Queue_Impl::value_type,
+                                 basic_queue_push_tag<Queue_Impl, Lock>, Lock, no_queue_stats> {
+public:
+
+    ///value type
+    using value_type = typename Queue_Impl::value_type;
+
+    ///return value from push() - it is void, however it serves as tag type for space reservation
+    using void_t = basic_queue_push_tag<Queue_Impl, Lock>;
+    friend struct awaitable_reserved_space<void_t>;
+
+    ///Push to queue
+    /**
+     * @param args arguments to construct item
+     * @return awaitable (co_await). If there is a space in the queue, the operation finishes
+     * immediately and new item is pushed to the queue. If the queue is full,
+     * returned object is set to pending state. Push operation continues
+     * when someone removes an item from the queue
+     */
+    template<typename ... Args >
+    requires(std::is_constructible_v<value_type, Args...>)
+    awaitable<void_t> push(Args && ... args) {
+        value_type v(std::forward<Args>(args)...);
+        if (_queue.try_push(std::move(v))) {
+            notify_consumers();
+            return {};
+        }
+        return push_async_cb(this, std::move(v));
+    }
+
+    ///pop from queue
+    /**
+     * @return awaitable object which eventually receives the item. You
+     * need co_await on result.
+     */
+    awaitable<value_type> pop() {
+        auto v = _queue.try_pop();
+        if (v) {
+            notify_producers();
+            return awaitable<value_type>(std::move(*v));
+        }
+        return pop_async_cb(this);
+    }
+
+    ///Push multiple items to queue
+    /**
+     * Pushes items without lock while there is a space, then hands items over to all
+     * waiting consumers in one pass
+     *
+     * @param items items to push. Items are moved out of the span
+     * @return awaitable (co_await). It is resolved when all items are in the queue
+     *
+     * @note the span must stay valid until the awaitable is resolved
+     */
+    awaitable<void_t> push_many(std::span<value_type> items) {
+        std::size_t pos = 0;
+        while (pos < items.size() && _queue.try_push(std::move(items[pos]))) ++pos;
+        if (pos) notify_consumers();
+        if (pos == items.size()) return {};
+        return push_many_cb(this, items.subspan(pos));
+    }
+
+    ///Pop multiple items from queue
+    /**
+     * Pops all available items (up to size of the span) without lock. If there is
+     * less than min items, the consumer is suspended and resumed once, when at least min
+     * items has been received.
+     *
+     * @param out span which receives items
+     * @param min minimal count of items (clamped to 1...out.size())
+     * @return awaitable count of items stored to the span. If the queue is closed, it
+     * returns count of items received so far, or nullopt if there are none
+     *
+     * @note the span must stay valid until the awaitable is resolved
+     */
+    awaitable<std::size_t> pop_many(std::span<value_type> out, std::size_t min = 1) {
+        if (out.empty()) return std::size_t(0);
+        min = std::clamp<std::size_t>(min, 1, out.size());
+        std::size_t n = pop_into(out, 0);
+        if (n) notify_producers();
+        if (n >= min) return n;
+        return pop_many_cb(this, out, n, min);
+    }
+
+    ///clear whole queue. The function also resumes all stuck producers
+    void clear() {
+        while (pop().is_ready());
+    }
+
+protected:
+
+    using waiters = basic_queue_waiters<basic_queue, value_type, void_t, Lock, no_queue_stats>;
+    friend waiters;
+
+    template<typename X>
+    using slot = typename waiters::template slot<X>;
+    template<typename X>
+    using link_list_queue = typename waiters::template link_list_queue<X>;
+    using typename waiters::pop_result;
+    using typename waiters::push_async_payload;
+    using typename waiters::push_many_payload;
+    using typename waiters::pop_many_payload;
+    using typename waiters::resume_list;
+    using waiters::park_waiter;
+    using waiters::unpark_waiter;
+    using waiters::_mx;
+    using waiters::_pop_queue;
+    using waiters::_push_queue;
+    using waiters::_pop_many_queue;
+    using waiters::_push_many_queue;
+    using waiters::_closed;
+
+    struct push_async_cb : slot<push_async_payload> {
+        basic_queue *me;
+        template<typename ... Args>
+        requires(std::is_constructible_v<value_type, Args...>)
+        push_async_cb (basic_queue *me, Args && ... args):slot<push_async_payload>(std::forward<Args>(args)...),me(me) {}
+        prepared_coro operator()(awaitable<void_t>::result r) {
+            if (!r) return {};
+            {
+                lock_guard _(me->_mx);
+                me->_push_waiting.fetch_add(1, std::memory_order_seq_cst);
+                if (!me->try_push_locked(this->payload.val)) {
+                    this->payload.r = std::move(r);
+                    me->park_waiter(me->_push_queue, this);
+                    return {};
+                }
+                me->_push_waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            me->notify_consumers();
+            return r();
+        }
+    };
+
+    friend struct push_async_cb;
+
+    struct push_many_cb : slot<push_many_payload> {
+        basic_queue *me;
+        push_many_cb(basic_queue *me, std::span<value_type> items):me(me) {
+            this->payload.items = items;
+        }
+        prepared_coro operator()(awaitable<void_t>::result r) {
+            if (!r) return {};
+            //the slot can be resolved by other thread once it is registered
+            basic_queue *q = me;
+            bool pushed;
+            bool wait;
+            {
+                lock_guard _(q->_mx);
+                auto &p = this->payload;
+                q->_push_waiting.fetch_add(1, std::memory_order_seq_cst);
+                pushed = q->try_push_locked(p.items[p.pos]);
+                if (pushed) {
+                    ++p.pos;
+                    while (p.pos < p.items.size() && q->_queue.try_push(std::move(p.items[p.pos]))) ++p.pos;
+                }
+                wait = p.pos < p.items.size();
+                if (wait) {
+                    p.r = std::move(r);
+                    q->park_waiter(q->_push_many_queue, this);
+                } else {
+                    q->_push_waiting.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if (pushed) q->notify_consumers();
+            if (wait) return {};
+            return r();
+        }
+    };
+
+    struct pop_async_cb: slot<pop_result> {
+        basic_queue *me;
+        pop_async_cb(basic_queue *me):me(me) {}
+        prepared_coro operator() (pop_result r) {
+            std::optional<value_type> v;
+            {
+                lock_guard _(me->_mx);
+                me->_pop_waiting.fetch_add(1, std::memory_order_seq_cst);
+                v = me->try_pop_locked();
+                if (!v) {
+                    if (!r) {
+                        me->_pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                        return {};
+                    }
+                    if (me->_closed) {
+                        me->_pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                        return (r =  std::nullopt);
+                    }
+                    this->payload = std::move(r);
+                    me->park_waiter(me->_pop_queue, this);
+                    return {};
+                }
+                me->_pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            me->notify_producers();
+            return r(std::move(*v));
+        }
+    };
+
+    struct pop_many_cb : slot<pop_many_payload> {
+        basic_queue *me;
+        pop_many_cb(basic_queue *me, std::span<value_type> out, std::size_t filled, std::size_t min):me(me) {
+            this->payload.out = out;
+            this->payload.filled = filled;
+            this->payload.min = min;
+        }
+        prepared_coro operator()(awaitable<std::size_t>::result r) {
+            //the slot can be resolved by other thread once it is registered
+            basic_queue *q = me;
+            auto &p = this->payload;
+            std::size_t filled;
+            bool popped;
+            bool wait;
+            {
+                lock_guard _(q->_mx);
+                q->_pop_waiting.fetch_add(1, std::memory_order_seq_cst);
+                auto v = q->try_pop_locked();
+                popped = v.has_value();
+                if (popped) {
+                    p.out[p.filled] = std::move(*v);
+                    p.filled = q->pop_into(p.out, p.filled + 1);
+                }
+                filled = p.filled;
+                wait = filled < p.min && r && !q->_closed;
+                if (wait) {
+                    p.r = std::move(r);
+                    q->park_waiter(q->_pop_many_queue, this);
+                } else {
+                    q->_pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if (popped) q->notify_producers();
+            if (wait) return {};
+            if (filled >= p.min) return r(filled);
+            if (!r) return {};
+            if (filled) return r(filled);
+            return (r = std::nullopt);
+        }
+    };
+
+    //a waiter has been removed from a list, it is no longer announced
+    void waiter_released(bool producer) {
+        (producer?_push_waiting:_pop_waiting).fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    //pop under lock, after the consumer was announced in _pop_waiting
+    //a producer which claimed a position before it could see the counter is waited for
+    std::optional<value_type> try_pop_locked() {
+        auto v = _queue.try_pop();
+        while (!v && !_queue.is_empty()) {
+            std::this_thread::yield();
+            v = _queue.try_pop();
+        }
+        return v;
+    }
+
+    //push under lock, after the producer was announced in _push_waiting
+    bool try_push_locked(value_type &val) {
+        bool ok = _queue.try_push(std::move(val));
+        while (!ok && !_queue.is_full()) {
+            std::this_thread::yield();
+            ok = _queue.try_push(std::move(val));
+        }
+        return ok;
+    }
+
+    //returns the first waiter, which is claimed, but stays registered until it receives a value
+    //waiters which lost their select() or timed out are removed
+    template<typename X>
+    slot<X> *first_claimed(link_list_queue<X> &q) {
+        while (q.first && !q.first->claim.claim()) unpark_waiter(q);
+        if (q.first) q.first->claim = {};
+        return q.first;
+    }
+
+    //pops available items to the span
+    std::size_t pop_into(std::span<value_type> out, std::size_t filled) {
+        while (filled < out.size()) {
+            auto v = _queue.try_pop();
+            if (!v) break;
+            out[filled] = std::move(*v);
+            ++filled;
+        }
+        return filled;
+    }
+
+    //called after an item has been pushed. Hands items over to all suspended consumers in one pass
+    void notify_consumers() {
+        //the position was claimed by a seq_cst operation - either we see the consumer,
+        //or the consumer sees the claimed position (see try_pop_locked)
+        if (!_pop_waiting.load(std::memory_order_seq_cst)) return;
+        resume_list rl;
+        bool popped = false;
+        {
+            lock_guard _(_mx);
+            while (true) {
+                if (_pop_queue.first) {
+                    //claim the waiter only if there is an item for it
+                    if (_queue.is_empty()) break;
+                    auto s = first_claimed(_pop_queue);
+                    if (!s) continue;
+                    auto v = try_pop_locked();
+                    if (!v) break;
+                    popped = true;
+                    unpark_waiter(_pop_queue);
+                    rl.push_back(s->payload(std::move(*v)));
+                } else if (_pop_many_queue.first) {
+                    auto &p = _pop_many_queue.first->payload;
+                    std::size_t filled = pop_into(p.out, p.filled);
+                    popped = popped || filled != p.filled;
+                    p.filled = filled;
+                    if (filled < p.min) break;
+                    unpark_waiter(_pop_many_queue);
+                    rl.push_back(p.r(filled));
+                } else {
+                    break;
+                }
+            }
+        }
+        //items have been removed, producers can wait for space
+        if (popped) notify_producers();
+    }
+
+    //called after an item has been removed. Moves items of all suspended producers to the queue
+    void notify_producers() {
+        if (!_push_waiting.load(std::memory_order_seq_cst)) return;
+        resume_list rl;
+        bool pushed = false;
+        {
+            lock_guard _(_mx);
+            while (true) {
+                if (_push_queue.first) {
+                    if (_queue.is_full()) break;
+                    auto s = first_claimed(_push_queue);
+                    if (!s) continue;
+                    if (!try_push_locked(s->payload.val)) break;
+                    pushed = true;
+                    unpark_waiter(_push_queue);
+                    rl.push_back(s->payload.r());
+                } else if (_push_many_queue.first) {
+                    auto &p = _push_many_queue.first->payload;
+                    while (p.pos < p.items.size() && _queue.try_push(std::move(p.items[p.pos]))) {
+                        ++p.pos;
+                        pushed = true;
+                    }
+                    if (p.pos < p.items.size()) break;
+                    unpark_waiter(_push_many_queue);
+                    rl.push_back(p.r());
+                } else {
+                    break;
+                }
+            }
+        }
+        //items have been added, consumers can wait for them
+        if (pushed) notify_consumers();
+    }
+
+    //registers consumer of select()
+    //an available item can be taken by a consumer on the fast path, so the case is claimed
+    //first. If the item is gone, the claimed case waits for the next one
+    prepared_coro arm_pop(slot<pop_result> &s, pop_result r, claim_token tkn) {
+        std::optional<value_type> v;
+        {
+            lock_guard _(_mx);
+            _pop_waiting.fetch_add(1, std::memory_order_seq_cst);
+            if (_queue.is_empty()) {
+                if (!_closed) {
+                    s.payload = std::move(r);
+                    s.claim = tkn;
+                    park_waiter(_pop_queue, &s);
+                    return {};
+                }
+                _pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                tkn.claim();
+                return (r = std::nullopt);
+            }
+            if (!tkn.claim()) {
+                _pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                return (r = std::nullopt);
+            }
+            v = try_pop_locked();
+            if (!v) {
+                if (_closed) {
+                    _pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+                    return (r = std::nullopt);
+                }
+                s.payload = std::move(r);
+                park_waiter(_pop_queue, &s);
+                return {};
+            }
+            _pop_waiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_producers();
+        return r(std::move(*v));
+    }
+
+    //registers producer of select()
+    prepared_coro arm_push(slot<push_async_payload> &s, awaitable<void_t>::result r, claim_token tkn) {
+        {
+            lock_guard _(_mx);
+            _push_waiting.fetch_add(1, std::memory_order_seq_cst);
+            if (_queue.is_full()) {
+                s.payload.r = std::move(r);
+                s.claim = tkn;
+                park_waiter(_push_queue, &s);
+                return {};
+            }
+            if (!tkn.claim()) {
+                _push_waiting.fetch_sub(1, std::memory_order_relaxed);
+                return (r = std::nullopt);
+            }
+            if (!try_push_locked(s.payload.val)) {
+                s.payload.r = std::move(r);
+                park_waiter(_push_queue, &s);
+                return {};
+            }
+            _push_waiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_consumers();
+        return r();
+    }
+
+    template<typename Scheduler, typename Timeout>
+    awaitable<value_type> pop_timeout(Scheduler &sch, Timeout tm) {
+        auto item = _queue.try_pop();
+        if (item) {
+            notify_producers();
+            return awaitable<value_type>(std::move(*item));
+        }
+        return with_timeout<value_type>(typename waiters::select_pop_case(*this), sch, tm,
+                [](pop_result r, auto &&v) -> prepared_coro {
+            if (v.index() == 0) return r(std::move(std::get<0>(v)));
+            return (r = std::nullopt);
+        });
+    }
+
+    template<typename Scheduler, typename Timeout, typename ... Args>
+    awaitable<bool> push_timeout(Scheduler &sch, Timeout tm, Args && ... args) {
+        value_type item(std::forward<Args>(args)...);
+        if (_queue.try_push(std::move(item))) {
+            notify_consumers();
+            return true;
+        }
+        return with_timeout<bool>(typename waiters::select_push_case(*this, std::move(item)), sch, tm,
+                [](awaitable<bool>::result r, auto &&v) -> prepared_coro {
+            return r(v.index() == 0);
+        });
+    }
+
+    Queue_Impl _queue;
+    std::atomic<std::size_t> _pop_waiting = {0};
+    std::atomic<std::size_t> _push_waiting = {0};
+
+public:
+    static constexpr std::size_t push_awaitable_size() {return std::max(sizeof(push_async_cb), sizeof(push_many_cb));}
+};
+
+///Multi-producer multi-consumer queue with lock-free fast path
+/**
+ * @tparam T type of item
+ * @tparam count capacity of the queue (power of two is recommended)
+ * @tparam Lock lock which protects lists of waiting coroutines
+ */
+template<typename T, unsigned int count, basic_lockable Lock = std::mutex>
+class mpmc_queue : public basic_queue<mpmc_ring<T, count>, Lock> {};
+
+}
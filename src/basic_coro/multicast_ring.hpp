@@ -0,0 +1,418 @@
+#pragma once
+
+#include "awaitable.hpp"
+#include "basic_lockable.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace coro {
+
+///what happens, when a publisher reaches the slowest reader
+enum class multicast_overflow {
+    ///publisher is suspended until the slowest reader releases a slot (backpressure)
+    block,
+    ///publisher overwrites unread slots, the reader skips lost values (see reader::lost())
+    lag
+};
+
+///multicast ring buffer with per-reader cursors (disruptor)
+/**
+ * Publisher writes a value once to a slot of the ring. Every reader has own cursor
+ * and receives a const reference to the same slot, nothing is copied. Readers which
+ * are not behind the publisher doesn't suspend, they read the ring directly.
+ *
+ * @code
+ * coro::multicast_ring<tick> ring(1024, coro::multicast_overflow::lag);
+ *
+ * coroutine<void> consumer(coro::multicast_ring<tick> &ring) {
+ *      coro::multicast_ring<tick>::reader rd(ring);
+ *      while (true) {
+ *          const tick &t = co_await rd.next();    //reference is valid until next call of next()
+ *          process(t);
+ *      }
+ * }
+ *
+ * co_await ring.publish(t);
+ * @endcode
+ *
+ * A reader holds the slot it received until it calls next() again. The held value is never
+ * overwritten. In block mode the held slot is not reused until released. In lag mode
+ * the publisher never waits: if it reaches a held slot, the value stays with
+ * its readers and the slot continues with a spare node (so the ring allocates
+ * at most one spare per reader holding an overwritten value).
+ *
+ * @tparam T type of value
+ * @tparam Lock lock which protects cursors. Use std::mutex if you need to work in
+ * multithreaded environment
+ */
+template<typename T, basic_lockable Lock = empty_lockable>
+class multicast_ring {
+protected:
+    struct slot_node;
+public:
+
+    using value_type = T;
+
+    ///construct the ring
+    /**
+     * @param capacity count of slots, rounded up to power of two
+     * @param policy overflow policy
+     */
+    explicit multicast_ring(std::size_t capacity, multicast_overflow policy = multicast_overflow::block)
+        :_mask(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1)
+        ,_storage(std::make_unique<slot_node[]>(_mask + 1))
+        ,_slots(std::make_unique<slot_node *[]>(_mask + 1))
+        ,_policy(policy) {
+        for (std::size_t i = 0; i <= _mask; ++i) _slots[i] = &_storage[i];
+    }
+
+    multicast_ring(const multicast_ring &) = delete;
+    multicast_ring &operator=(const multicast_ring &) = delete;
+
+    ///destructor - readers must be destroyed before
+    ~multicast_ring() {
+        for (std::size_t i = 0; i <= _mask; ++i) free_spare(_slots[i]);
+        while (_spare) free_spare(std::exchange(_spare, _spare->next_spare));
+    }
+
+    class reader;
+
+    ///publish a value
+    /**
+     * @param args arguments to construct the value
+     * @return awaitable. If there is a free slot, the value is published immediately. Otherwise
+     * the publisher is suspended until a reader releases the slot. If the ring is closed, the
+     * awaitable is resolved without value
+     *
+     * @note if you don't co_await on result, the value is published only if it can be
+     * published without blocking
+     */
+    template<typename ... Args>
+    requires(std::is_constructible_v<value_type, Args...>)
+    awaitable<void> publish(Args && ... args) {
+        wakeup wk(this);
+        lock_guard _(_mx);
+        if (_closed) return std::nullopt;
+        if (_publishers.first || !can_write()) {
+            return publish_cb(this, std::forward<Args>(args)...);
+        }
+        write(wk, std::forward<Args>(args)...);
+        return {};
+    }
+
+    ///close the ring
+    /**
+     * Suspended publishers and readers are resumed without value. Readers can
+     * read remaining values, then they receive no value
+     */
+    void close() {
+        reader *rds;
+        publish_cb *pubs;
+        {
+            lock_guard _(_mx);
+            _closed = true;
+            rds = std::exchange(_waiting, nullptr);
+            pubs = std::exchange(_publishers.first, nullptr);
+            _publishers.last = nullptr;
+        }
+        while (rds) {
+            auto n = rds->_wnext;
+            rds->_r = std::nullopt;
+            rds = n;
+        }
+        while (pubs) {
+            auto n = pubs->_next;
+            pubs->_r = std::nullopt;
+            pubs = n;
+        }
+    }
+
+    ///retrieve capacity (after rounding)
+    std::size_t get_capacity() const {return _mask + 1;}
+
+    ///reader of the ring - keeps cursor
+    /**
+     * The reader starts at the current position of the publisher, so it receives values
+     * published after it was constructed. The object can't be moved, it must stay alive
+     * while it is awaited
+     */
+    class reader {
+    public:
+        ///construct reader and register it to the ring
+        explicit reader(multicast_ring &ring):_ring(&ring) {
+            lock_guard _(_ring->_mx);
+            _seq = _ring->_head;
+            _next = _ring->_readers;
+            if (_next) _next->_prev = this;
+            _ring->_readers = this;
+        }
+
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+
+        ///unregister the reader, releases the held slot
+        ~reader() {
+            bool was_waiting = false;
+            {
+                wakeup wk(_ring);
+                lock_guard _(_ring->_mx);
+                if (_prev) _prev->_next = _next; else _ring->_readers = _next;
+                if (_next) _next->_prev = _prev;
+                for (reader **p = &_ring->_waiting; *p; p = &(*p)->_wnext) {
+                    if (*p == this) {*p = _wnext; was_waiting = true; break;}
+                }
+                _ring->release(*this);
+                _ring->flush_publishers(wk);
+            }
+            if (was_waiting) _r = std::nullopt;
+        }
+
+        ///receive next value
+        /**
+         * Releases the previously received slot.
+         * @return awaitable which receives const reference to the value. The reference is
+         * valid until next() is called again or the reader is destroyed. If the ring is closed
+         * and there are no more values, the awaitable is resolved without value
+         *
+         * @note you need co_await on result, otherwise the value is skipped
+         */
+        awaitable<const value_type &> next() {
+            wakeup wk(_ring);
+            lock_guard _(_ring->_mx);
+            _ring->release(*this);
+            _ring->flush_publishers(wk);
+            if (_seq != _ring->_head) {
+                _ring->take(*this);
+                return _ring->held_value(*this);
+            }
+            if (_ring->_closed) return std::nullopt;
+            return [this](typename awaitable<const value_type &>::result r) -> prepared_coro {
+                return _ring->wait(*this, std::move(r));
+            };
+        }
+
+        ///retrieve count of values which were overwritten before the reader read them (lag mode)
+        /**
+         * Counted when the reader skips them, i.e. during next()
+         */
+        std::uint64_t lost() const {
+            lock_guard _(_ring->_mx);
+            return _lost;
+        }
+
+        ///retrieve count of values published but not yet read
+        std::uint64_t backlog() const {
+            lock_guard _(_ring->_mx);
+            return _ring->_head - _seq;
+        }
+
+    protected:
+        friend class multicast_ring;
+
+        multicast_ring *_ring;
+        //sequence number of next value to read
+        std::uint64_t _seq = 0;
+        std::uint64_t _lost = 0;
+        //node of slot _seq-1 held by the reader (in lag mode it can be already detached from the ring)
+        slot_node *_held = nullptr;
+        reader *_next = nullptr;
+        reader *_prev = nullptr;
+        //link in list of waiting readers and wake up list
+        reader *_wnext = nullptr;
+        typename awaitable<const value_type &>::result _r;
+    };
+
+protected:
+
+    //storage of a value. The node is held by readers, which received the value
+    struct slot_node {
+        std::optional<value_type> value;
+        //count of readers holding the node
+        std::uint32_t holders = 0;
+        //node was replaced in the ring while held (lag mode), it is released by the last holder
+        bool detached = false;
+        //node was allocated as spare (not part of the initial storage)
+        bool spare = false;
+        slot_node *next_spare = nullptr;
+    };
+
+    struct publish_cb {
+        multicast_ring *me;
+        value_type val;
+        awaitable<void>::result _r;
+        publish_cb *_next = nullptr;
+
+        template<typename ... Args>
+        publish_cb(multicast_ring *me, Args && ... args):me(me),val(std::forward<Args>(args)...) {}
+        publish_cb(publish_cb &&other):me(other.me),val(std::move(other.val)) {}
+
+        prepared_coro operator()(awaitable<void>::result r) {
+            if (!r) return {};
+            wakeup wk(me);
+            lock_guard _(me->_mx);
+            if (me->_closed) return (r = std::nullopt);
+            if (!me->_publishers.first && me->can_write()) {
+                me->write(wk, std::move(val));
+                return r();
+            }
+            _r = std::move(r);
+            _next = nullptr;
+            if (me->_publishers.last) me->_publishers.last->_next = this;
+            else me->_publishers.first = this;
+            me->_publishers.last = this;
+            return {};
+        }
+    };
+
+    //resumes readers and publishers after the lock is released (declare before lock_guard)
+    struct wakeup {
+        multicast_ring *ring;
+        reader *readers = nullptr;
+        publish_cb *publishers = nullptr;
+        publish_cb *last_publisher = nullptr;
+
+        explicit wakeup(multicast_ring *ring):ring(ring) {}
+        wakeup(const wakeup &) = delete;
+        wakeup &operator=(const wakeup &) = delete;
+
+        ~wakeup() {
+            while (readers) {
+                auto rd = readers;
+                readers = rd->_wnext;
+                rd->_r(ring->held_value(*rd));
+            }
+            while (publishers) {
+                auto p = publishers;
+                publishers = p->_next;
+                p->_r();
+            }
+        }
+    };
+
+    struct publisher_list {
+        publish_cb *first = nullptr;
+        publish_cb *last = nullptr;
+    };
+
+    Lock _mx;
+    std::size_t _mask;
+    std::unique_ptr<slot_node[]> _storage;
+    std::unique_ptr<slot_node *[]> _slots;
+    //released detached nodes, reused when a held slot is overwritten
+    slot_node *_spare = nullptr;
+    multicast_overflow _policy;
+    //sequence number of next value to publish
+    std::uint64_t _head = 0;
+    //cached lowest sequence which must not be overwritten, it is never above the real one
+    std::uint64_t _gate = 0;
+    reader *_readers = nullptr;
+    reader *_waiting = nullptr;
+    publisher_list _publishers;
+    bool _closed = false;
+
+    //lowest sequence protected by the reader (block mode)
+    std::uint64_t protected_seq(const reader &rd) const {
+        return rd._held?rd._seq - 1:rd._seq;
+    }
+
+    bool can_write() {
+        //lag mode never waits for readers
+        if (_policy == multicast_overflow::lag) return true;
+        if (_head - _gate <= _mask) return true;
+        _gate = _head;
+        for (auto rd = _readers; rd; rd = rd->_next) _gate = std::min(_gate, protected_seq(*rd));
+        return _head - _gate <= _mask;
+    }
+
+    template<typename ... Args>
+    void write(wakeup &wk, Args && ... args) {
+        slot_node *&sl = _slots[_head & _mask];
+        if (sl->holders) {
+            //value is still held by a reader (lag mode), keep it and continue with a spare node
+            sl->detached = true;
+            sl = alloc_spare();
+        }
+        sl->value.emplace(std::forward<Args>(args)...);
+        ++_head;
+        while (_waiting) {
+            auto rd = _waiting;
+            _waiting = rd->_wnext;
+            take(*rd);
+            rd->_wnext = wk.readers;
+            wk.readers = rd;
+        }
+    }
+
+    //reader takes the slot at its cursor, skips overwritten slots
+    void take(reader &rd) {
+        std::uint64_t oldest = _head > _mask?_head - _mask - 1:0;
+        if (rd._seq < oldest) {
+            rd._lost += oldest - rd._seq;
+            rd._seq = oldest;
+        }
+        _gate = std::min(_gate, rd._seq);
+        rd._held = _slots[rd._seq & _mask];
+        ++rd._held->holders;
+        ++rd._seq;
+    }
+
+    //reader releases the held node
+    void release(reader &rd) {
+        slot_node *n = std::exchange(rd._held, nullptr);
+        if (n && !--n->holders && n->detached) {
+            n->value.reset();
+            n->detached = false;
+            n->next_spare = _spare;
+            _spare = n;
+        }
+    }
+
+    slot_node *alloc_spare() {
+        if (_spare) return std::exchange(_spare, _spare->next_spare);
+        slot_node *n = new slot_node;
+        n->spare = true;
+        return n;
+    }
+
+    static void free_spare(slot_node *n) {
+        if (n->spare) delete n;
+    }
+
+    static const value_type &held_value(const reader &rd) {
+        return *rd._held->value;
+    }
+
+    //publishes values of suspended publishers, while there is space
+    void flush_publishers(wakeup &wk) {
+        while (_publishers.first && can_write()) {
+            auto p = _publishers.first;
+            _publishers.first = p->_next;
+            if (!_publishers.first) _publishers.last = nullptr;
+            write(wk, std::move(p->val));
+            p->_next = nullptr;
+            if (wk.last_publisher) wk.last_publisher->_next = p;
+            else wk.publishers = p;
+            wk.last_publisher = p;
+        }
+    }
+
+    prepared_coro wait(reader &rd, typename awaitable<const value_type &>::result r) {
+        if (!r) return {};
+        wakeup wk(this);
+        lock_guard _(_mx);
+        if (rd._seq != _head) {
+            take(rd);
+            return r(held_value(rd));
+        }
+        if (_closed) return (r = std::nullopt);
+        rd._r = std::move(r);
+        rd._wnext = _waiting;
+        _waiting = &rd;
+        return {};
+    }
+};
+
+}
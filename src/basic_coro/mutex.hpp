@@ -2,6 +2,8 @@
 #include "awaitable.hpp"
 #include "awaitable_transform.hpp"
 #include "basic_coro/concepts.hpp"
+#include "claim_token.hpp"
+#include "select.hpp"
 #include <array>
 
 namespace coro {
@@ -107,6 +109,19 @@ public:
         return slot_cb(this);
     }
 
+    class select_lock_case;
+
+    ///attempt to lock with a timeout
+    /**
+     * @param sch scheduler (scheduler, manual_scheduler)
+     * @param dur timeout
+     * @return awaitable ownership. If the timeout expires, the ownership doesn't own the lock
+     *
+     * @note the timer is not armed, if try_lock() succeeds
+     */
+    template<typename Scheduler, typename Dur>
+    awaitable<ownership> lock_for(Scheduler &sch, Dur dur);
+
 
 protected:
     //item of linked list of the requests and queue
@@ -115,12 +130,14 @@ protected:
         slot *_next;
         //pointer to awaitable to be resolved when ownership is retrieved
         awaitable<ownership> *_resume;
+        //request with timeout (timed_slot)
+        bool _timed;
 
     };
 
     struct slot_cb : slot{
         mutex *_me;
-        slot_cb(mutex *me):_me(me) {}
+        slot_cb(mutex *me):slot{},_me(me) {}
         prepared_coro operator()(awaitable<ownership>::result r) {
             if (!r) return {};
             //zero next
@@ -145,14 +162,19 @@ protected:
     //add slot to request stack
     prepared_coro add_request(slot *s) {
         //atomically add slot to _requests stack - linked list
-        while (!_requests.compare_exchange_strong(s->_next, s));
+        //(previous top is kept in a local, the slot can be processed by other thread once pushed)
+        slot *top = s->_next;
+        while (!_requests.compare_exchange_strong(top, s)) s->_next = top;
         //this checks whether this slot was added as first
-        if (s->_next == nullptr) {
+        if (top == nullptr) {
             //in this case, lock is successful, we own the lock
             //prepare queue of possible other request and at bottom of request stack atomically
             make_queue(_requests.exchange(get_doorman()), s);
             //resume this slot
-            return resume_slot(s);
+            if (claim_slot(s)) return resume_slot(s);
+            //request timed out meanwhile, pass the lock
+            static_cast<timed_slot *>(s)->release();
+            return unlock();
         }
         //request added, nothing to resume
         return {};
@@ -162,6 +184,8 @@ protected:
     prepared_coro resume_slot(slot *s) {
         //convert pointer back to result
         awaitable<ownership>::result r(s->_resume);
+        //slot is no longer needed
+        if (s->_timed) static_cast<timed_slot *>(s)->release();
         //set ownership to resume
         return r(ownership(this));
     }
@@ -180,28 +204,132 @@ protected:
 
     //unlock and transfer ownership
     prepared_coro unlock() {
-        //if queue is empty, probably nobody is waiting
-        if (!_queue) {
-            slot *d = get_doorman();
-            slot *need = d;
-            //try exchange doorman by nullptr
-            if (_requests.compare_exchange_strong(need, nullptr)) {
-                //if successed, lock is unlocked
-                //nothing to resume
-                return {};
+        while (true) {
+            //if queue is empty, probably nobody is waiting
+            if (!_queue) {
+                slot *d = get_doorman();
+                slot *need = d;
+                //try exchange doorman by nullptr
+                if (_requests.compare_exchange_strong(need, nullptr)) {
+                    //if successed, lock is unlocked
+                    //nothing to resume
+                    return {};
+                }
+                //there are requests, make queue
+                make_queue(_requests.exchange(d), d);
+            }
+            //pick first from the queue
+            auto f = _queue;
+            //advance queue
+            _queue = f->_next;
+            //resume picked slot
+            if (claim_slot(f)) return resume_slot(f);
+            //request timed out, it is left in the queue, drop it now
+            static_cast<timed_slot *>(f)->release();
+        }
+    }
+
+    //request with timeout - shared by the mutex and the waiter
+    struct timed_slot: slot {
+        static constexpr unsigned int pending = 0;
+        static constexpr unsigned int claiming = 1;
+        static constexpr unsigned int claimed = 2;
+        static constexpr unsigned int dead = 3;
+
+        claim_token _claim;
+        std::atomic<unsigned int> _state = {pending};
+        std::atomic<unsigned int> _refs = {2};
+
+        //called by the mutex - the token is not accessed once the slot is abandoned
+        bool claim() {
+            unsigned int st = pending;
+            if (!_state.compare_exchange_strong(st, claiming, std::memory_order_acq_rel)) return false;
+            bool ok = _claim.claim();
+            _state.store(ok?claimed:dead, std::memory_order_release);
+            _state.notify_all();
+            return ok;
+        }
+
+        //called by the waiter, when other case won. Waits for running claim()
+        void abandon() {
+            unsigned int st = pending;
+            while (!_state.compare_exchange_strong(st, dead, std::memory_order_acq_rel)) {
+                if (st != claiming) return;
+                _state.wait(claiming, std::memory_order_acquire);
+                st = pending;
             }
-            //there are requests, make queue
-            make_queue(_requests.exchange(d), d);
         }
-        //pick first from the queue
-        auto f = _queue;
-        //advance queue
-        _queue = f->_next;
-        //resume picked slot
-        return resume_slot(f);
+
+        void release() {
+            if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+        }
+    };
+
+    static bool claim_slot(slot *s) {
+        return !s->_timed || static_cast<timed_slot *>(s)->claim();
+    }
+
+public:
+
+    ///case of select() which locks the mutex
+    /**
+     * Requests can't be removed from the lock-free request stack. When other case wins, the
+     * request is abandoned in O(1), it is skipped and released later by unlock()
+     */
+    class select_lock_case {
+    public:
+        using value_type = ownership;
+
+        explicit select_lock_case(mutex &mx):_mx(&mx) {}
+        select_lock_case(select_lock_case &&other)
+            :_mx(other._mx),_slot(std::exchange(other._slot, nullptr)) {}
+        select_lock_case &operator=(select_lock_case &&other) = delete;
+        ~select_lock_case() {
+            if (_slot) _slot->release();
+        }
+
+        awaitable<ownership> arm(claim_token tkn) {
+            return [this, tkn](awaitable<ownership>::result r) -> prepared_coro {
+                if (!r) return {};
+                _slot = new timed_slot{};
+                _slot->_next = nullptr;
+                _slot->_resume = r.release();
+                _slot->_timed = true;
+                _slot->_claim = tkn;
+                return _mx->add_request(_slot);
+            };
+        }
+
+        prepared_coro disarm() {
+            if (!_slot) return {};
+            //the request lost, so the mutex will not touch the result
+            _slot->abandon();
+            awaitable<ownership>::result r(std::exchange(_slot->_resume, nullptr));
+            return (r = std::nullopt);
+        }
+
+    protected:
+        mutex *_mx;
+        timed_slot *_slot = nullptr;
+    };
+
+    ///create case of select() which locks the mutex
+    select_lock_case lock_case() {
+        return select_lock_case(*this);
     }
 };
 
+template<typename Scheduler, typename Dur>
+inline awaitable<mutex::ownership> mutex::lock_for(Scheduler &sch, Dur dur) {
+    auto test = try_lock();
+    if (test) return test;
+    return with_timeout<ownership>(select_lock_case(*this), sch, dur,
+            [](awaitable<ownership>::result r, auto &&v) -> prepared_coro {
+        if (v.index() == 0) return r(std::move(std::get<0>(v)));
+        return r(ownership());
+    });
+}
+
 
 ///implements multiple mutex locking
 /**
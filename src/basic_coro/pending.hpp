@@ -59,7 +59,7 @@ public:
     @param executor executor to start / resume coroutine
     */
     template<std::invocable<prepared_coro> _Executor>
-    pending(T awt, _Executor executor)
+    pending(T awt, _Executor &&executor)
         : _awt(std::move(awt))
         , _awaiting_state(_awt.await_ready()?get_sentinel():nullptr) {
             if (_awaiting_state.load(std::memory_order_relaxed) == nullptr) {
@@ -69,7 +69,7 @@ public:
 
     template<typename X, std::invocable<prepared_coro> _Executor>
     requires (std::is_invocable_r_v<T, X>)
-    pending(X &&fn, _Executor executor)
+    pending(X &&fn, _Executor &&executor)
         :_awt(std::forward<X>(fn)())
         , _awaiting_state(_awt.await_ready()?get_sentinel():nullptr) {
             if (_awaiting_state.load(std::memory_order_relaxed) == nullptr) {
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "allocator.hpp"
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace coro {
+
+///pooled allocator for coroutine frames - keeps freed frames in per-thread free lists
+/**
+ * The allocator divides frames into size classes (multiples of granularity). Each
+ * thread keeps a small cache of free blocks for every size class, so allocation and
+ * deallocation of a frame is just push or pop on a thread local linked list. No
+ * lock is involved in this case.
+ *
+ * Frames can be released in a different thread than the thread which allocated them. The
+ * released block simply goes to the cache of the releasing thread. When the cache of a
+ * size class grows above cache_limit, half of the cache is moved as one batch to the
+ * global depot. When the cache is empty, a batch is taken from the depot
+ * before a new block is allocated by ::operator new. This ensures that memory freely
+ * flows between producing and consuming threads.
+ *
+ * Frames larger than max_pooled_size are allocated directly by ::operator new.
+ *
+ * The allocator doesn't need an instance, so it is not required to pass it as an argument
+ * of the coroutine.
+ *
+ * @code
+ * coroutine<int, pool_allocator> my_coro(int a, int b) {
+ *      co_return a+b;
+ * }
+ * @endcode
+ *
+ * @note blocks cached by a thread are released when the thread exits. Blocks stored in
+ * the depot are released at the exit of the program. After the thread cache is destroyed
+ * (for example frames released by destructors of static objects), blocks are
+ * allocated and released directly by ::operator new and ::operator delete
+ */
+class pool_allocator {
+public:
+
+    ///size of size class - all blocks are allocated as multiple of this value
+    static constexpr std::size_t granularity = 64;
+    ///largest block held by the pool
+    static constexpr std::size_t max_pooled_size = 4096;
+    ///count of size classes
+    static constexpr std::size_t class_count = max_pooled_size / granularity;
+    ///maximum count of blocks of the one size class held in the thread cache
+    static constexpr std::size_t cache_limit = 64;
+    ///count of blocks exchanged with the depot in one step
+    static constexpr std::size_t batch_size = cache_limit / 2;
+    ///maximum count of batches of the one size class held in the depot
+    static constexpr std::size_t depot_limit = 64;
+
+    struct overrides {
+        template<typename ... Args>
+        void *operator new(std::size_t sz, Args && ...) {
+            return allocate(sz);
+        }
+        void operator delete(void *ptr, std::size_t sz) {
+            deallocate(ptr, sz);
+        }
+    };
+
+    ///allocate block
+    /**
+     * @param sz required size
+     * @return pointer to allocated block
+     */
+    static void *allocate(std::size_t sz) {
+        if (sz > max_pooled_size) return ::operator new(sz);
+        auto idx = size_class(sz);
+        //full size of the class, the block can be released to a cache of other thread
+        if (torn_down()) return ::operator new(class_size(idx));
+        bucket &b = local_cache().buckets[idx];
+        if (!b.head) {
+            depot_get(idx, b);
+            if (!b.head) return ::operator new(class_size(idx));
+        }
+        node *n = b.head;
+        b.head = n->next;
+        --b.count;
+        return n;
+    }
+
+    ///deallocate block
+    /**
+     * @param ptr pointer to block
+     * @param sz size of the block (the same value as passed to allocate())
+     */
+    static void deallocate(void *ptr, std::size_t sz) {
+        if (sz > max_pooled_size || torn_down()) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto idx = size_class(sz);
+        bucket &b = local_cache().buckets[idx];
+        if (b.count >= cache_limit) depot_put(idx, b);
+        node *n = reinterpret_cast<node *>(ptr);
+        n->next = b.head;
+        b.head = n;
+        ++b.count;
+    }
+
+    ///calculate size class index for given size
+    static constexpr std::size_t size_class(std::size_t sz) {
+        return sz?(sz - 1) / granularity:0;
+    }
+
+    ///calculate allocated size for given size class
+    static constexpr std::size_t class_size(std::size_t idx) {
+        return (idx + 1) * granularity;
+    }
+
+protected:
+
+    struct node {
+        //next node in the list
+        node *next;
+        //next batch in the depot (valid only for the first node of the batch)
+        node *next_batch;
+    };
+
+    struct bucket {
+        node *head = nullptr;
+        std::size_t count = 0;
+    };
+
+    struct thread_cache {
+        std::array<bucket, class_count> buckets = {};
+        thread_cache() = default;
+        thread_cache(const thread_cache &) = delete;
+        thread_cache &operator=(const thread_cache &) = delete;
+        ~thread_cache() {
+            for (auto &b: buckets) {
+                release_list(b.head);
+                b = {};
+            }
+            torn_down() = true;
+        }
+    };
+
+    struct depot_class {
+        std::mutex mx;
+        node *batches = nullptr;
+        std::size_t count = 0;
+    };
+
+    struct depot {
+        std::array<depot_class, class_count> classes;
+        depot() = default;
+        depot(const depot &) = delete;
+        depot &operator=(const depot &) = delete;
+        ~depot() {
+            for (auto &c: classes) {
+                while (c.batches) {
+                    node *n = c.batches;
+                    c.batches = n->next_batch;
+                    release_list(n);
+                }
+            }
+        }
+    };
+
+    static thread_cache &local_cache() {
+        static thread_local thread_cache cache;
+        return cache;
+    }
+
+    //thread cache of current thread was destroyed (trivial type, it is never destroyed)
+    static bool &torn_down() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    static depot &global_depot() {
+        static depot d;
+        return d;
+    }
+
+    static void release_list(node *n) {
+        while (n) {
+            node *x = n;
+            n = n->next;
+            ::operator delete(x);
+        }
+    }
+
+    //moves batch_size blocks from the bucket to the depot
+    static void depot_put(std::size_t idx, bucket &b) {
+        node *first = b.head;
+        node *last = first;
+        for (std::size_t i = 1; i < batch_size; ++i) last = last->next;
+        b.head = last->next;
+        b.count -= batch_size;
+        last->next = nullptr;
+        depot_class &c = global_depot().classes[idx];
+        {
+            std::lock_guard _(c.mx);
+            if (c.count < depot_limit) {
+                first->next_batch = c.batches;
+                c.batches = first;
+                ++c.count;
+                return;
+            }
+        }
+        release_list(first);
+    }
+
+    //retrieves one batch from the depot to an empty bucket
+    static void depot_get(std::size_t idx, bucket &b) {
+        depot_class &c = global_depot().classes[idx];
+        std::lock_guard _(c.mx);
+        node *n = c.batches;
+        if (n) {
+            c.batches = n->next_batch;
+            --c.count;
+            b.head = n;
+            b.count = batch_size;
+        }
+    }
+};
+
+static_assert(coro_allocator<pool_allocator>);
+
+}
@@ -1,7 +1,10 @@
 #pragma once
+#include <concepts>
 #include <memory>
 #include <coroutine>
 #include <queue>
+#include <span>
+#include <type_traits>
 #include "exceptions.hpp"
 
 
@@ -241,5 +244,47 @@ prepared_coro aggregate_prepared_coros(Args ...  ) noexcept {
     co_return;
 }
 
+///executor which accepts coroutines one by one, or a batch of coroutines
+/**
+ * The batch executor receives a span of prepared coroutines. It can move them out. Coroutines
+ * which remain in the span are resumed by the caller after the executor returns
+ */
+template<typename T>
+concept scheduler_executor = std::invocable<T, prepared_coro> || std::invocable<T, std::span<prepared_coro> >;
+
+///executor which is called with a batch of coroutines
+/**
+ * An executor which accepts only std::span<prepared_coro> is always called with a batch. An executor
+ * which also accepts single prepared_coro must opt in by declaring the member type batch_executor_tag,
+ * otherwise it is called per coroutine. So a generic lambda ([](auto &&c){...}) is never
+ * instantiated with the span
+ */
+template<typename T>
+concept batch_executor = (!std::invocable<T, prepared_coro> || requires {typename std::remove_cvref_t<T>::batch_executor_tag;})
+                         && std::invocable<T, std::span<prepared_coro> >;
+
+///pass prepared coroutines to an executor
+/**
+ * Uses batch interface of the executor, if it is batch_executor. Coroutines which remain
+ * in the span are resumed in current thread
+ *
+ * @param executor executor
+ * @param coros coroutines
+ */
+template<scheduler_executor Executor>
+void execute_batch(Executor &executor, std::span<prepared_coro> coros) {
+    if constexpr(batch_executor<Executor &>) {
+        executor(coros);
+    } else {
+        for (auto &c: coros) if (c) executor(std::move(c));
+    }
+    for (auto &c: coros) c.resume();
+}
+
+///executor which resumes coroutines in current thread
+struct inline_executor {
+    void operator()(prepared_coro coro) const {coro.resume();}
+};
+
 
 }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "queue.hpp"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+
+namespace coro {
+
+///priority queue with fixed set of priority levels - helper class for coro_basic_queue
+/**
+ * Each priority level is a FIFO. pop() returns the oldest item of the highest
+ * non-empty level. Level 0 is the highest priority.
+ *
+ * Optional aging protects lower levels from starvation. Every pop() which skips
+ * a non-empty level increases its counter. When the counter reaches the aging limit,
+ * the oldest item of that level is returned instead and the counter is reset.
+ *
+ * @tparam T type of item
+ * @tparam levels count of priority levels (max 64)
+ * @tparam Proj function which returns level of an item (unsigned integer). Levels
+ * out of range are clamped to the lowest priority
+ */
+template<typename T, unsigned int levels, typename Proj>
+struct priority_levels_queue {
+public:
+
+    static_assert(levels > 0 && levels <= 64, "count of levels must be in range 1-64");
+
+    using value_type = T;
+
+    ///construct the queue
+    /**
+     * @param aging count of pops which can skip a non-empty level, before the
+     * level is served. Zero disables aging
+     * @param proj projection, returns level of an item
+     */
+    explicit priority_levels_queue(unsigned int aging = 0, Proj proj = {})
+        :_aging(aging), _proj(std::move(proj)) {}
+
+    ///determine whether queue is full
+    static constexpr bool is_full() {return false;}
+
+    ///determine whether queue is empty
+    bool is_empty() const {
+        return _mask == 0;
+    }
+
+    ///push item
+    /**
+     * @param args arguments to construct item
+     */
+    template<typename ... Args>
+    void push(Args && ... args) {
+        T val(std::forward<Args>(args)...);
+        auto lv = static_cast<unsigned int>(std::invoke(_proj, std::as_const(val)));
+        if (lv >= levels) lv = levels - 1;
+        _levels[lv].push(std::move(val));
+        _mask |= std::uint64_t(1) << lv;
+    }
+
+    ///pop item
+    /**
+     * @return item of highest priority (or starved item, if aging is enabled)
+     *
+     * @note it doesn't check for emptyness, use is_empty() before calling of this function
+     */
+    T pop() {
+        auto sel = static_cast<unsigned int>(std::countr_zero(_mask));
+        if (_aging) {
+            //non-empty levels of lower priority than sel
+            std::uint64_t skipped = _mask & (~std::uint64_t(1) << sel);
+            unsigned int starved = levels;
+            while (skipped) {
+                auto l = static_cast<unsigned int>(std::countr_zero(skipped));
+                skipped &= skipped - 1;
+                if (++_skipped[l] >= _aging && starved == levels) starved = l;
+            }
+            if (starved != levels) sel = starved;
+            _skipped[sel] = 0;
+        }
+        auto &q = _levels[sel];
+        T r = q.pop();
+        if (q.is_empty()) {
+            _mask &= ~(std::uint64_t(1) << sel);
+            _skipped[sel] = 0;
+        }
+        return r;
+    }
+
+protected:
+    std::array<unlimited_queue<T>, levels> _levels;
+    std::array<unsigned int, levels> _skipped = {};
+    std::uint64_t _mask = 0;
+    unsigned int _aging;
+    Proj _proj;
+};
+
+///queue which delivers items by priority
+/**
+ * Consumers always receive the highest-priority item. A consumer waiting on empty
+ * queue receives the first pushed item.
+ *
+ * @code
+ * struct message {unsigned int prio; std::string text;};
+ * coro::priority_queue<message, 2, decltype([](const message &m){return m.prio;})> q(1000);
+ * @endcode
+ *
+ * @tparam T type of item
+ * @tparam levels count of priority levels (max 64), level 0 is the highest priority
+ * @tparam Proj function which returns level of an item
+ * @tparam Lock specifies internal lock type. Use std::mutex if you need to work in multithreaded environmnet
+ * @tparam Stats instrumentation policy (no_queue_stats, queue_stats). Time in the queue
+ *  is measured in FIFO order, so it is an approximation
+ */
+template<typename T, unsigned int levels, typename Proj, basic_lockable Lock = empty_lockable,
+         queue_stats_policy Stats = no_queue_stats>
+class priority_queue : public basic_queue<priority_levels_queue<T, levels, Proj>, Lock, Stats> {
+public:
+    ///construct the queue
+    /**
+     * @param aging count of pops which can skip a non-empty level, before the
+     * level is served. Zero (default) disables aging
+     * @param proj projection, returns level of an item
+     */
+    explicit priority_queue(unsigned int aging = 0, Proj proj = {})
+        :basic_queue<priority_levels_queue<T, levels, Proj>, Lock, Stats>(aging, std::move(proj)) {}
+};
+
+}
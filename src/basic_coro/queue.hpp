@@ -2,7 +2,14 @@
 
 #include "awaitable.hpp"
 #include "basic_lockable.hpp"
-#include <deque>
+#include "claim_token.hpp"
+#include "queue_stats.hpp"
+#include "select.hpp"
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace coro {
 
@@ -12,8 +19,10 @@ namespace coro {
  * @tparam count queue limit. If this value is zero, the queue is unlimited
  * @tparam Lock specifies internal lock type. Default value empty_lockable, which disables locking
  *  Use std::mutex if you need to work in multithreaded environmnet
+ * @tparam Stats instrumentation policy. Default value no_queue_stats disables instrumentation. Use
+ *  queue_stats<> to collect statistics
  */
-template<typename T, unsigned int count = 0, typename Lock = empty_lockable>
+template<typename T, unsigned int count = 0, typename Lock = empty_lockable, typename Stats = no_queue_stats>
 class queue;
 
 ///limited queue - helper class for coro_basic_queue
@@ -81,18 +90,41 @@ protected:
 };
 
 
-template<typename T>
+///unlimited queue - helper class for coro_basic_queue
+/**
+ * Items are stored in linked chunks. Released chunks are kept in a small cache
+ * of spare chunks, so a queue in steady state doesn't allocate memory.
+ *
+ * @tparam T type of item in queue
+ * @tparam chunk_size count of items in a chunk
+ * @tparam spare_chunks max count of released chunks kept for reuse
+ */
+template<typename T,
+         unsigned int chunk_size = (sizeof(T) < 64 ? 1024 / sizeof(T) : 16),
+         unsigned int spare_chunks = 4>
 struct unlimited_queue {
 public:
 
+    static_assert(chunk_size > 0, "chunk_size must not be zero");
+
     using value_type = T;
 
+    unlimited_queue() = default;
+    unlimited_queue(const unlimited_queue &) = delete;
+    unlimited_queue &operator=(const unlimited_queue &) = delete;
+
+    ~unlimited_queue() {
+        while (!is_empty()) pop();
+        release_list(_head);
+        release_list(_spare);
+    }
+
     ///determine whether queue is full
     static constexpr bool is_full() {return false;}
 
     ///determine whether queue is empty
     constexpr bool is_empty() const {
-        return _q.empty();
+        return _head == _tail && _head_pos == _tail_pos;
     }
 
     ///push item
@@ -104,7 +136,14 @@ public:
      */
     template<typename ... Args>
     constexpr void push(Args && ... args) {
-        _q.emplace_back(std::forward<Args>(args)...);
+        if (_tail_pos == chunk_size || !_tail) {
+            chunk *c = alloc_chunk();
+            if (_tail) _tail->next = c; else _head = c;
+            _tail = c;
+            _tail_pos = 0;
+        }
+        std::construct_at(&_tail->items[_tail_pos].val, std::forward<Args>(args)...);
+        ++_tail_pos;
     }
 
     ///pop item
@@ -114,37 +153,514 @@ public:
      * @note it doesn't check for emptyness, use is_empty() before calling of this function
      */
     constexpr T pop() {
-        T r = std::move(_q.front());
-        _q.pop_back();
+        item &x = _head->items[_head_pos];
+        T r = std::move(x.val);
+        std::destroy_at(&x.val);
+        ++_head_pos;
+        if (_head == _tail) {
+            //queue is empty, reuse the chunk from beginning
+            if (_head_pos == _tail_pos) _head_pos = _tail_pos = 0;
+        } else if (_head_pos == chunk_size) {
+            chunk *c = _head;
+            _head = c->next;
+            _head_pos = 0;
+            release_chunk(c);
+        }
         return r;
     }
 
 
 protected:
 
-    std::deque<T> _q;
+    struct item {
+        T val;
+        item() {}
+        ~item() {}
+    };
+
+    struct chunk {
+        chunk *next = nullptr;
+        item items[chunk_size];
+    };
+
+    chunk *_head = nullptr;
+    chunk *_tail = nullptr;
+    chunk *_spare = nullptr;
+    unsigned int _head_pos = 0;
+    unsigned int _tail_pos = 0;
+    unsigned int _spare_count = 0;
+
+    chunk *alloc_chunk() {
+        if (_spare) {
+            chunk *c = _spare;
+            _spare = c->next;
+            c->next = nullptr;
+            --_spare_count;
+            return c;
+        }
+        return new chunk;
+    }
+
+    void release_chunk(chunk *c) {
+        if (_spare_count < spare_chunks) {
+            c->next = _spare;
+            _spare = c;
+            ++_spare_count;
+        } else {
+            delete c;
+        }
+    }
+
+    static void release_list(chunk *c) {
+        while (c) {
+            chunk *n = c->next;
+            delete c;
+            c = n;
+        }
+    }
 };
 
 
-template<typename A,typename B>
+///limited queue with capacity specified at runtime - helper class for coro_basic_queue
+/**
+ * Items are stored in a ring allocated on the heap. The capacity is rounded up
+ * to power of two.
+ *
+ * @tparam T type of item in queue
+ */
+template<typename T>
+struct dynamic_limited_queue {
+public:
+
+    using value_type = T;
+
+    ///construct the queue
+    /**
+     * @param capacity max count of items, rounded up to power of two (at least 1)
+     */
+    explicit dynamic_limited_queue(std::size_t capacity)
+        :_mask(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1)
+        ,_items(std::make_unique<item[]>(_mask + 1)) {}
+
+    dynamic_limited_queue(const dynamic_limited_queue &) = delete;
+    dynamic_limited_queue &operator=(const dynamic_limited_queue &) = delete;
+
+    ~dynamic_limited_queue() {
+        while (!is_empty()) pop();
+    }
+
+    ///determine whether queue is full
+    bool is_full() const {
+        return _front - _back > _mask;
+    }
+
+    ///determine whether queue is empty
+    bool is_empty() const {
+        return _front == _back;
+    }
+
+    ///push item
+    /**
+     * @param args arguments to construct item
+     *
+     * @note it doesn't check fullness, use is_full() before you call this function
+     *
+     */
+    template<typename ... Args>
+    void push(Args && ... args) {
+        item &x = _items[_front & _mask];
+        std::construct_at(&x.val, std::forward<Args>(args)...);
+        ++_front;
+    }
+
+    ///pop item
+    /**
+     * @return item removed from queue
+     *
+     * @note it doesn't check for emptyness, use is_empty() before calling of this function
+     */
+    T pop() {
+        item &x = _items[_back & _mask];
+        T r = std::move(x.val);
+        std::destroy_at(&x.val);
+        ++_back;
+        return r;
+    }
+
+    ///retrieve capacity (after rounding)
+    std::size_t capacity() const {
+        return _mask + 1;
+    }
+
+protected:
+
+    struct item {
+        T val;
+        item() {}
+        ~item() {}
+    };
+
+    std::size_t _mask;
+    std::unique_ptr<item[]> _items;
+    std::size_t _front = 0;
+    std::size_t _back = 0;
+};
+
+
+template<typename A,typename B, typename C = no_queue_stats>
 struct basic_queue_push_tag {};
 
 
+///lists of suspended producers and consumers - shared part of basic_queue implementations
+/**
+ * Contains slots of waiters, lists of waiters with O(1) removal, close() and cases
+ * of select() including operations with a timeout, which are built on them.
+ *
+ * @tparam Derived the queue (CRTP). It must implement arm_pop(), arm_push(), pop_timeout()
+ * and push_timeout(). It can hide waiter_released(), which is called under the lock
+ * when a waiter is removed from a list
+ * @tparam T type of item
+ * @tparam VoidT return value of push()
+ * @tparam Lock object to lock lists
+ * @tparam Stats instrumentation policy (no_queue_stats, queue_stats)
+ */
+template<typename Derived, typename T, typename VoidT, basic_lockable Lock, queue_stats_policy Stats>
+class basic_queue_waiters {
+public:
+
+    ///closes the queue
+    /**
+     * When queue is closed, coroutines can't co_await on the queue. Any
+     * attempt of co_await is reported as nullopt value, which leads
+     * to the execption await_canceled_exception, if not tested
+     */
+    void close() {
+        link_list_queue<pop_result> slots;
+        link_list_queue<pop_many_payload> many_slots;
+        {
+            lock_guard _(_mx);
+            _closed = true;
+            while (auto s = pop_claimed(_pop_queue)) slots.push(s);
+            while (auto s = unpark_waiter(_pop_many_queue)) many_slots.push(s);
+        }
+        while (auto s = slots.pop()) {
+            s->payload = std::nullopt;
+        }
+        while (auto s = many_slots.pop()) {
+            if (s->payload.filled) s->payload.r(s->payload.filled);
+            else s->payload.r = std::nullopt;
+        }
+    }
+
+protected:
+
+    using pop_result = typename awaitable<T>::result;
+
+    template<typename _Payload>
+    struct slot {
+        _Payload payload = {};
+        slot *next = nullptr;
+        slot *prev = nullptr;
+        ///claim of the waiter, if it is a case of select()
+        claim_token claim = {};
+        ///time when the waiter has been suspended (instrumentation)
+        [[no_unique_address]] typename Stats::stamp_type since = {};
+
+        slot(_Payload p):payload(std::move(p)) {}
+
+        template<typename ... Args>
+        requires(std::is_constructible_v<_Payload, Args...>)
+        slot(Args && ... args):payload(std::forward<Args>(args)...) {}
+    };
+
+    struct push_async_payload {
+        awaitable<VoidT>::result r;
+        T val;
+
+        template<typename ... Args>
+        requires(std::is_constructible_v<T, Args...>)
+        push_async_payload(Args && ... args):val(std::forward<Args>(args)...) {}
+    };
+
+    struct push_many_payload {
+        awaitable<VoidT>::result r;
+        std::span<T> items;
+        std::size_t pos = 0;
+    };
+
+    struct pop_many_payload {
+        awaitable<std::size_t>::result r;
+        std::span<T> out;
+        std::size_t filled = 0;
+        std::size_t min = 1;
+    };
+
+    //coroutines resumed after the lock is released (declare before lock_guard)
+    using resume_list = std::vector<prepared_coro>;
+
+    template<typename X>
+    struct link_list_queue {
+        slot<X> *first = {};
+        slot<X> *last = {};
+
+        void push(slot<X> *s) {
+            s->next = nullptr;
+            s->prev = last;
+            if (last) {
+                last->next = s;
+                last = s;
+            } else {
+                first = last = s;
+            }
+        }
+
+        slot<X> *pop() {
+            auto r = first;
+            if (r) {
+                first = r->next;
+                if (first) first->prev = nullptr; else last = nullptr;
+                r->next = nullptr;
+            }
+            return r;
+        }
+
+        //removes slot in O(1), returns false if the slot is not linked
+        bool remove(slot<X> *s) {
+            if (s->prev) s->prev->next = s->next;
+            else if (first == s) first = s->next;
+            else return false;
+            if (s->next) s->next->prev = s->prev; else last = s->prev;
+            s->next = s->prev = nullptr;
+            return true;
+        }
+
+    };
+
+    //producers wait in _push_queue and _push_many_queue
+    template<typename X>
+    static constexpr bool is_producer = std::is_same_v<X, push_async_payload> || std::is_same_v<X, push_many_payload>;
+
+    //called under the lock, when a waiter has been removed from a list
+    void waiter_released(bool) {}
+
+    //registers waiter
+    template<typename X>
+    void park_waiter(link_list_queue<X> &q, slot<X> *s) {
+        _stats.waiter_suspended(is_producer<X>, s->since);
+        q.push(s);
+    }
+
+    //removes the first waiter
+    template<typename X>
+    slot<X> *unpark_waiter(link_list_queue<X> &q) {
+        auto s = q.pop();
+        if (s) released(s);
+        return s;
+    }
+
+    //removes a waiter in O(1), if it is still registered
+    template<typename X>
+    void withdraw_waiter(link_list_queue<X> &q, slot<X> *s) {
+        if (q.remove(s)) released(s);
+    }
+
+    //removes the first waiter, skips waiters which lost their select() or timed out
+    template<typename X>
+    slot<X> *pop_claimed(link_list_queue<X> &q) {
+        auto s = unpark_waiter(q);
+        while (s && !s->claim.claim()) s = unpark_waiter(q);
+        return s;
+    }
+
+    template<typename X>
+    void released(slot<X> *s) {
+        _stats.waiter_resumed(is_producer<X>, s->since);
+        static_cast<Derived *>(this)->waiter_released(is_producer<X>);
+    }
+
+    //withdraws consumer of select()
+    prepared_coro disarm_pop(slot<pop_result> &s) {
+        {
+            lock_guard _(_mx);
+            withdraw_waiter(_pop_queue, &s);
+        }
+        return (s.payload = std::nullopt);
+    }
+
+    //withdraws producer of select()
+    prepared_coro disarm_push(slot<push_async_payload> &s) {
+        {
+            lock_guard _(_mx);
+            withdraw_waiter(_push_queue, &s);
+        }
+        return (s.payload.r = std::nullopt);
+    }
+
+    Lock _mx;
+    [[no_unique_address]] Stats _stats;
+    link_list_queue<pop_result> _pop_queue;
+    link_list_queue<push_async_payload> _push_queue;
+    link_list_queue<pop_many_payload> _pop_many_queue;
+    link_list_queue<push_many_payload> _push_many_queue;
+    bool _closed = false;
+
+public:
+
+    ///case of select() which pops an item from the queue
+    /**
+     * The case registers a waiter to the queue, which is withdrawn in O(1) when other case
+     * of the select() wins. If the queue is closed and the case wins, select() reports
+     * await_canceled_exception (as pop())
+     */
+    class select_pop_case {
+    public:
+        using value_type = T;
+
+        explicit select_pop_case(Derived &q):_q(&q) {}
+
+        awaitable<value_type> arm(claim_token tkn) {
+            return [this, tkn](pop_result r) {
+                return _q->arm_pop(_slot, std::move(r), tkn);
+            };
+        }
+
+        prepared_coro disarm() {
+            return _q->disarm_pop(_slot);
+        }
+
+    protected:
+        Derived *_q;
+        slot<pop_result> _slot;
+    };
+
+    ///case of select() which pushes an item to the queue
+    /**
+     * The item is pushed only if the case wins. Otherwise it is destroyed with the case
+     */
+    class select_push_case {
+    public:
+        using value_type = VoidT;
+
+        template<typename ... Args>
+        requires(std::is_constructible_v<T, Args...>)
+        explicit select_push_case(Derived &q, Args && ... args)
+            :_q(&q),_slot(std::forward<Args>(args)...) {}
+
+        awaitable<VoidT> arm(claim_token tkn) {
+            return [this, tkn](awaitable<VoidT>::result r) {
+                return _q->arm_push(_slot, std::move(r), tkn);
+            };
+        }
+
+        prepared_coro disarm() {
+            return _q->disarm_push(_slot);
+        }
+
+    protected:
+        Derived *_q;
+        slot<push_async_payload> _slot;
+    };
+
+    ///create case of select() which pops an item from this queue
+    /**
+     * @return case object, pass it to select(). Unlike pop(), the object doesn't remove
+     * anything from the queue until it is armed by select()
+     */
+    select_pop_case pop_case() {
+        return select_pop_case(static_cast<Derived &>(*this));
+    }
+
+    ///create case of select() which pushes an item to this queue
+    /**
+     * @param args arguments to construct the item
+     * @return case object, pass it to select()
+     */
+    template<typename ... Args>
+    requires(std::is_constructible_v<T, Args...>)
+    select_push_case push_case(Args && ... args) {
+        return select_push_case(static_cast<Derived &>(*this), std::forward<Args>(args)...);
+    }
+
+    ///pop from queue with a timeout
+    /**
+     * @param sch scheduler (scheduler, manual_scheduler)
+     * @param dur timeout
+     * @return awaitable object which eventually receives the item. If the timeout
+     * expires or the queue is closed, it is resolved without value
+     *
+     * @note the timer is not armed, if an item is available
+     */
+    template<typename Scheduler, typename Dur>
+    awaitable<T> pop_for(Scheduler &sch, Dur dur) {
+        return static_cast<Derived *>(this)->pop_timeout(sch, dur);
+    }
+
+    ///pop from queue with a deadline
+    /**
+     * @param sch scheduler (scheduler, manual_scheduler)
+     * @param tp deadline
+     * @return awaitable object which eventually receives the item. If the deadline
+     * is reached or the queue is closed, it is resolved without value
+     *
+     * @note the timer is not armed, if an item is available
+     */
+    template<typename Scheduler, typename TimePoint>
+    awaitable<T> pop_until(Scheduler &sch, TimePoint tp) {
+        return static_cast<Derived *>(this)->pop_timeout(sch, tp);
+    }
+
+    ///push to queue with a timeout
+    /**
+     * @param sch scheduler (scheduler, manual_scheduler)
+     * @param dur timeout
+     * @param args arguments to construct item
+     * @return awaitable, true if the item has been pushed, false if the timeout expired (the item is
+     * dropped)
+     *
+     * @note the timer is not armed, if there is a space in the queue
+     */
+    template<typename Scheduler, typename Dur, typename ... Args>
+    requires(std::is_constructible_v<T, Args...>)
+    awaitable<bool> push_for(Scheduler &sch, Dur dur, Args && ... args) {
+        return static_cast<Derived *>(this)->push_timeout(sch, dur, std::forward<Args>(args)...);
+    }
+
+    ///retrieve instrumentation object
+    /**
+     * @return reference to the Stats object. For queue_stats<>, call snapshot() to read
+     * statistics. It can be called from any thread, while the queue is in use
+     */
+    const Stats &get_stats() const {
+        return _stats;
+    }
+};
+
+
 ///basic coroutine queue
 /**
  *
  * @tparam Queue_Impl implementation of the queue = example limited_queue
  * @tparam Lock object to lock internals
+ * @tparam Stats instrumentation policy (no_queue_stats, queue_stats)
  */
-template<typename Queue_Impl, basic_lockable Lock = empty_lockable>
-class basic_queue {
+template<typename Queue_Impl, basic_lockable Lock = empty_lockable, queue_stats_policy Stats = no_queue_stats>
+class basic_queue: public basic_queue_waiters<basic_queue<Queue_Impl, Lock, Stats>, typename Queue_Impl::value_type,
+                                              basic_queue_push_tag<Queue_Impl, Lock, Stats>, Lock, Stats> {
 public:
 
     ///value type
     using value_type = typename Queue_Impl::value_type;
 
     ///return value from push() - it is void, however it serves as tag type for space reservation
-    using void_t = basic_queue_push_tag<Queue_Impl, Lock>;
+    using void_t = basic_queue_push_tag<Queue_Impl, Lock, Stats>;
+    friend struct awaitable_reserved_space<void_t>;
+
+    basic_queue() = default;
+
+    ///construct the queue, pass arguments to the constructor of Queue_Impl
+    template<typename ... Args>
+    requires(sizeof...(Args) > 0 && std::is_constructible_v<Queue_Impl, Args...>)
+    explicit basic_queue(Args && ... args):_queue(std::forward<Args>(args)...) {}
 
     ///Push to queue
     /**
@@ -188,57 +704,86 @@ public:
     }
 
 
-    ///clear whole queue. The function also resumes all stuck producers
-    void clear() {
-        while (pop().is_ready());
-    }
-
-    ///closes the queue
+    ///Push multiple items to queue
     /**
-     * When queue is closed, coroutines can't co_await on the queue. Any
-     * attempt of co_await is reported as nullopt value, which leads
-     * to the execption await_canceled_exception, if not tested
+     * Moves items under single lock. Items are handed over to all waiting consumers
+     * in one pass, consumers are resumed after the lock is released.
+     *
+     * @param items items to push. Items are moved out of the span
+     * @return awaitable (co_await). It is resolved when all items are in the queue. If the
+     * queue becomes full, the operation continues when consumers remove items
+     *
+     * @note the span must stay valid until the awaitable is resolved. If you
+     * don't co_await on result, only items which fit into the queue are pushed
      */
-    void close() {
-        slot<typename awaitable<value_type>::result> *slots;
+    awaitable<void_t> push_many(std::span<value_type> items) {
+        std::size_t pos = 0;
         {
+            resume_list rl;
             lock_guard _(_mx);
-            _closed = true;
-            slots = _pop_queue.first;
-            _pop_queue.first = _pop_queue.last = nullptr;
-        }
-        while (slots) {
-            auto s = slots;
-            slots = s->next;
-            s->payload = std::nullopt;
+            while (pos < items.size() && !_queue.is_full()) {
+                push_item(std::move(items[pos]), rl);
+                ++pos;
+            }
         }
+        if (pos == items.size()) return {};
+        return push_many_cb(this, items.subspan(pos));
     }
 
+    ///Pop multiple items from queue
+    /**
+     * Moves all available items (up to size of the span) under single lock. If there is
+     * less than min items, the consumer is suspended and resumed once, when at least min
+     * items has been received.
+     *
+     * @param out span which receives items
+     * @param min minimal count of items (clamped to 1...out.size())
+     * @return awaitable count of items stored to the span. If the queue is closed, it
+     * returns count of items received so far, or nullopt if there are none
+     *
+     * @note the span must stay valid until the awaitable is resolved. You need
+     * co_await on result, otherwise received items can be lost
+     */
+    awaitable<std::size_t> pop_many(std::span<value_type> out, std::size_t min = 1) {
+        if (out.empty()) return std::size_t(0);
+        min = std::clamp<std::size_t>(min, 1, out.size());
+        resume_list rl;
+        lock_guard _(_mx);
+        std::size_t n = pop_into(out, 0, rl);
+        if (n >= min) return n;
+        return pop_many_cb(this, out, n, min);
+    }
 
+    ///clear whole queue. The function also resumes all stuck producers
+    void clear() {
+        while (pop().is_ready());
+    }
 
-protected:
-
-    template<typename _Payload>
-    struct slot {
-        _Payload payload = {};
-        slot *next = nullptr;
-
-        slot(_Payload p):payload(std::move(p)) {}
-
-        template<typename ... Args>
-        requires(std::is_constructible_v<_Payload, Args...>)
-        slot(Args && ... args):payload(std::forward<Args>(args)...) {}
-    };
 
+protected:
 
-    struct push_async_payload {
-        awaitable<void_t>::result r;
-        value_type val;
+    using waiters = basic_queue_waiters<basic_queue, value_type, void_t, Lock, Stats>;
+    friend waiters;
 
-        template<typename ... Args>
-        requires(std::is_constructible_v<value_type, Args...>)
-        push_async_payload(Args && ... args):val(std::forward<Args>(args)...) {}
-    };
+    template<typename X>
+    using slot = typename waiters::template slot<X>;
+    template<typename X>
+    using link_list_queue = typename waiters::template link_list_queue<X>;
+    using typename waiters::pop_result;
+    using typename waiters::push_async_payload;
+    using typename waiters::push_many_payload;
+    using typename waiters::pop_many_payload;
+    using typename waiters::resume_list;
+    using waiters::park_waiter;
+    using waiters::unpark_waiter;
+    using waiters::pop_claimed;
+    using waiters::_mx;
+    using waiters::_stats;
+    using waiters::_pop_queue;
+    using waiters::_push_queue;
+    using waiters::_pop_many_queue;
+    using waiters::_push_many_queue;
+    using waiters::_closed;
 
     struct push_async_cb : slot<push_async_payload> {
         basic_queue *me;
@@ -247,20 +792,70 @@ protected:
         push_async_cb (basic_queue *me, Args && ... args):slot<push_async_payload>(std::forward<Args>(args)...),me(me) {}
         prepared_coro operator()(awaitable<void_t>::result r) {
             if (!r) return {};
+            prepared_coro resm;
             lock_guard _(me->_mx);
             if (me->_queue.is_full()) {
                 this->payload.r = std::move(r);
-                me->_push_queue.push(this);
+                me->park_waiter(me->_push_queue, this);
                 return {};
             } else {
-                return me->push2(std::move(this->payload.val));
+                //space has been released by other thread meanwhile
+                resm = me->push2(std::move(this->payload.val));
+                return r();
             }
         }
     };
 
     friend struct push_async_cb;
 
-    struct pop_async_cb: slot<typename awaitable<value_type>::result> {
+    struct push_many_cb : slot<push_many_payload> {
+        basic_queue *me;
+        push_many_cb(basic_queue *me, std::span<value_type> items):me(me) {
+            this->payload.items = items;
+        }
+        prepared_coro operator()(awaitable<void_t>::result r) {
+            if (!r) return {};
+            resume_list rl;
+            lock_guard _(me->_mx);
+            auto &p = this->payload;
+            while (p.pos < p.items.size() && !me->_queue.is_full()) {
+                me->push_item(std::move(p.items[p.pos]), rl);
+                ++p.pos;
+            }
+            if (p.pos < p.items.size()) {
+                p.r = std::move(r);
+                me->park_waiter(me->_push_many_queue, this);
+                return {};
+            }
+            return r();
+        }
+    };
+
+    struct pop_many_cb : slot<pop_many_payload> {
+        basic_queue *me;
+        pop_many_cb(basic_queue *me, std::span<value_type> out, std::size_t filled, std::size_t min):me(me) {
+            this->payload.out = out;
+            this->payload.filled = filled;
+            this->payload.min = min;
+        }
+        prepared_coro operator()(awaitable<std::size_t>::result r) {
+            resume_list rl;
+            lock_guard _(me->_mx);
+            auto &p = this->payload;
+            p.filled = me->pop_into(p.out, p.filled, rl);
+            if (p.filled >= p.min) return r(p.filled);
+            if (!r) return {};
+            if (me->_closed) {
+                if (p.filled) return r(p.filled);
+                return (r = std::nullopt);
+            }
+            p.r = std::move(r);
+            me->park_waiter(me->_pop_many_queue, this);
+            return {};
+        }
+    };
+
+    struct pop_async_cb: slot<pop_result> {
         basic_queue *me;
         pop_async_cb(basic_queue *me):me(me) {}
         prepared_coro operator() (typename awaitable<value_type>::result r) {
@@ -273,7 +868,7 @@ protected:
                 }
 
                 this->payload = std::move(r);
-                me->_pop_queue.push(this);
+                me->park_waiter(me->_pop_queue, this);
                 return {};
             } else {
                 return r(me->pop2(resm).get());
@@ -283,84 +878,196 @@ protected:
 
 
     awaitable<value_type> pop2_full(prepared_coro &resm) {
-        awaitable<value_type> r ( _queue.pop());
-        slot<push_async_payload> *s = _push_queue.pop();
+        awaitable<value_type> r (dequeue_item());
+        slot<push_async_payload> *s = pop_claimed(_push_queue);
         if (s) {
-            _queue.push(std::move(s->payload.val));
+            enqueue_item(std::move(s->payload.val));
             resm = s->payload.r();
+        } else if (_push_many_queue.first) {
+            resm = refill_from_push_many();
         }
         return r;
     }
+    //moves next item of the first waiting push_many() to the queue
+    prepared_coro refill_from_push_many() {
+        auto s = _push_many_queue.first;
+        auto &p = s->payload;
+        enqueue_item(std::move(p.items[p.pos]));
+        ++p.pos;
+        if (p.pos < p.items.size()) return {};
+        unpark_waiter(_push_many_queue);
+        return p.r();
+    }
+    //hands item over to the first waiting pop_many()
+    prepared_coro feed_pop_many(value_type &&val) {
+        auto s = _pop_many_queue.first;
+        auto &p = s->payload;
+        p.out[p.filled] = std::move(val);
+        ++p.filled;
+        _stats.item_handed();
+        if (p.filled < p.min) return {};
+        unpark_waiter(_pop_many_queue);
+        return p.r(p.filled);
+    }
+    //pops items to the span, refills the queue from waiting producers
+    std::size_t pop_into(std::span<value_type> out, std::size_t filled, resume_list &rl) {
+        while (filled < out.size() && !_queue.is_empty()) {
+            if (_queue.is_full()) {
+                prepared_coro resm;
+                out[filled] = pop2_full(resm).await_resume();
+                if (resm) rl.push_back(std::move(resm));
+            } else {
+                out[filled] = dequeue_item();
+            }
+            ++filled;
+        }
+        return filled;
+    }
+    //pushes item to the queue or hands it to a waiting consumer, queue must not be full
+    void push_item(value_type &&val, resume_list &rl) {
+        prepared_coro resm = push2(std::move(val));
+        if (resm) rl.push_back(std::move(resm));
+    }
     awaitable<value_type> pop2(prepared_coro &resm) {
         if (_queue.is_full()) { //THIS removes whole branch if queue is unlimited
             return pop2_full(resm);
         } else {
-            return _queue.pop();
+            return dequeue_item();
         }
     }
     template<typename ... Args>
     prepared_coro push2(Args && ... args) {
          if (_queue.is_empty()) {
-            auto slot = _pop_queue.pop();
+            auto slot = pop_claimed(_pop_queue);
             if (slot) {
+                _stats.item_handed();
                 return slot->payload(std::forward<Args>(args)...);
+            } else if (_pop_many_queue.first) {
+                return feed_pop_many(value_type(std::forward<Args>(args)...));
             } else {
-                _queue.push(std::forward<Args>(args)...);
+                enqueue_item(std::forward<Args>(args)...);
             }
         } else {
-            _queue.push(std::forward<Args>(args)...);
+            enqueue_item(std::forward<Args>(args)...);
         }
         return {};
     }
 
 
-    template<typename X>
-    struct link_list_queue {
-        slot<X> *first = {};
-        slot<X> *last = {};
 
-        void push(slot<X> *s) {
-            if (last) {
-                last->next = s;
-                last = s;
-            } else {
-                first = last = s;
-            }
+    //registers consumer of select()
+    prepared_coro arm_pop(slot<pop_result> &s,
+                          typename awaitable<value_type>::result r, claim_token tkn) {
+        prepared_coro resm;
+        lock_guard _(_mx);
+        if (!_queue.is_empty()) {
+            if (!tkn.claim()) return (r = std::nullopt);
+            return r(pop2(resm).get());
+        }
+        if (_closed) {
+            tkn.claim();
+            return (r = std::nullopt);
         }
+        s.payload = std::move(r);
+        s.claim = tkn;
+        park_waiter(_pop_queue, &s);
+        return {};
+    }
 
-        slot<X> *pop() {
-            auto r = first;
-            if (r == last) {
-                last = first = nullptr;
-            } else {
-                first = first->next;
-            }
-            return r;
+    //registers producer of select()
+    prepared_coro arm_push(slot<push_async_payload> &s, awaitable<void_t>::result r, claim_token tkn) {
+        prepared_coro resm;
+        lock_guard _(_mx);
+        if (!_queue.is_full()) {
+            if (!tkn.claim()) return (r = std::nullopt);
+            resm = push2(std::move(s.payload.val));
+            return r();
         }
+        s.payload.r = std::move(r);
+        s.claim = tkn;
+        park_waiter(_push_queue, &s);
+        return {};
+    }
 
-    };
+    template<typename Scheduler, typename Timeout>
+    awaitable<value_type> pop_timeout(Scheduler &sch, Timeout tm) {
+        prepared_coro resm;
+        lock_guard _(_mx);
+        if (!_queue.is_empty()) return pop2(resm);
+        if (_closed) return std::nullopt;
+        return with_timeout<value_type>(typename waiters::select_pop_case(*this), sch, tm,
+                [](typename awaitable<value_type>::result r, auto &&v) -> prepared_coro {
+            if (v.index() == 0) return r(std::move(std::get<0>(v)));
+            return (r = std::nullopt);
+        });
+    }
+
+    template<typename Scheduler, typename Timeout, typename ... Args>
+    awaitable<bool> push_timeout(Scheduler &sch, Timeout tm, Args && ... args) {
+        prepared_coro resm;
+        lock_guard _(_mx);
+        if (!_queue.is_full()) {
+            resm = push2(std::forward<Args>(args)...);
+            return true;
+        }
+        return with_timeout<bool>(typename waiters::select_push_case(*this, std::forward<Args>(args)...), sch, tm,
+                [](awaitable<bool>::result r, auto &&v) -> prepared_coro {
+            return r(v.index() == 0);
+        });
+    }
+
+
+    template<typename ... Args>
+    void enqueue_item(Args && ... args) {
+        _queue.push(std::forward<Args>(args)...);
+        _stats.item_pushed();
+    }
+
+    value_type dequeue_item() {
+        _stats.item_popped();
+        return _queue.pop();
+    }
 
-    Lock _mx;
     Queue_Impl _queue;
-    link_list_queue<typename awaitable<value_type>::result> _pop_queue;
-    link_list_queue<push_async_payload> _push_queue;
-    bool _closed = false;
 
 public:
-    static constexpr std::size_t push_awaitable_size() {return sizeof(push_async_cb);}
-    friend struct awaitable_reserved_space<basic_queue_push_tag<Queue_Impl, Lock> >;
+
+    static constexpr std::size_t push_awaitable_size() {return std::max(sizeof(push_async_cb), sizeof(push_many_cb));}
 };
 
-template<typename T, unsigned int count, typename Lock>
-class queue : public basic_queue<limited_queue<T, count>, Lock > {};
+template<typename T, unsigned int count, typename Lock, typename Stats>
+class queue : public basic_queue<limited_queue<T, count>, Lock, Stats > {};
+
+template<typename T, typename Lock, typename Stats>
+class queue<T,0,Lock,Stats> : public basic_queue<unlimited_queue<T>, Lock, Stats > {};
 
-template<typename T, typename Lock>
-class queue<T,0,Lock> : public basic_queue<unlimited_queue<T>, Lock > {};
+///queue with capacity specified at runtime
+/**
+ * @tparam T type of value pushed to and poped from the queue
+ * @tparam Lock specifies internal lock type. Use std::mutex if you need to work in multithreaded environmnet
+ * @tparam Stats instrumentation policy (no_queue_stats, queue_stats)
+ */
+template<typename T, basic_lockable Lock = empty_lockable, queue_stats_policy Stats = no_queue_stats>
+class dynamic_queue : public basic_queue<dynamic_limited_queue<T>, Lock, Stats > {
+public:
+    ///construct the queue
+    /**
+     * @param capacity max count of items in the queue, rounded up to power of two
+     */
+    explicit dynamic_queue(std::size_t capacity)
+        :basic_queue<dynamic_limited_queue<T>, Lock, Stats >(capacity) {}
+
+    ///retrieve capacity of the queue (after rounding)
+    std::size_t get_capacity() const {
+        return this->_queue.capacity();
+    }
+};
 
 
-template<typename A, typename B>
-struct awaitable_reserved_space<basic_queue_push_tag<A,B> > {
-    static constexpr std::size_t value = sizeof(typename basic_queue<A, B>::push_async_cb);
+template<typename A, typename B, typename C>
+struct awaitable_reserved_space<basic_queue_push_tag<A,B,C> > {
+    static constexpr std::size_t value = std::max(sizeof(typename basic_queue<A, B, C>::push_async_cb),
+                                                  sizeof(typename basic_queue<A, B, C>::push_many_cb));
 };
 
 
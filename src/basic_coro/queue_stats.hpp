@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace coro {
+
+///instrumentation policy of basic_queue
+/**
+ * Hooks are called under the lock of the queue
+ *
+ * - stamp_type - time stamp stored in every waiter
+ * - item_pushed() - item has been stored to the queue
+ * - item_popped() - item has been removed from the queue
+ * - item_handed() - item has been handed over to a waiting consumer directly
+ * - waiter_suspended(producer, stamp) - waiter has been registered, stores time stamp
+ * - waiter_resumed(producer, stamp) - waiter has been removed (resumed or withdrawn)
+ */
+template<typename T>
+concept queue_stats_policy = requires(T &st, typename T::stamp_type &stamp, bool producer) {
+    {st.item_pushed()};
+    {st.item_popped()};
+    {st.item_handed()};
+    {st.waiter_suspended(producer, stamp)};
+    {st.waiter_resumed(producer, stamp)};
+};
+
+///default policy - instrumentation disabled
+/**
+ * All hooks are empty and the time stamp is an empty object, so the queue has
+ * the same size and code as without instrumentation
+ */
+struct no_queue_stats {
+    struct stamp_type {};
+    void item_pushed() {}
+    void item_popped() {}
+    void item_handed() {}
+    void waiter_suspended(bool, stamp_type &) {}
+    void waiter_resumed(bool, const stamp_type &) {}
+};
+
+///snapshot of queue statistics
+struct queue_stats_snapshot {
+    ///count of histogram buckets
+    static constexpr unsigned int buckets = 48;
+    ///log-bucketed histogram of durations in nanoseconds
+    /**
+     * Bucket 0 counts zero durations, bucket i counts durations in range
+     * [2^(i-1), 2^i) ns. The last bucket counts also all longer durations
+     */
+    using histogram = std::array<std::uint64_t, buckets>;
+
+    ///count of items in the queue
+    std::size_t depth = 0;
+    ///highest count of items in the queue
+    std::size_t high_water = 0;
+    ///count of suspended producers
+    std::size_t waiting_producers = 0;
+    ///count of suspended consumers
+    std::size_t waiting_consumers = 0;
+    ///total count of items passed through the queue (including items handed over directly)
+    std::uint64_t items = 0;
+    ///time items spent in the queue
+    histogram item_time = {};
+    ///time producers were suspended
+    histogram producer_wait = {};
+    ///time consumers were suspended
+    histogram consumer_wait = {};
+
+    ///retrieve upper bound of a bucket in nanoseconds (exclusive)
+    static constexpr std::uint64_t bucket_limit(unsigned int bucket) {
+        return std::uint64_t(1) << bucket;
+    }
+};
+
+///instrumentation of basic_queue
+/**
+ * @code
+ * coro::queue<message, 64, std::mutex, coro::queue_stats<> > q;
+ * //other thread
+ * auto snap = q.get_stats().snapshot();
+ * @endcode
+ *
+ * Counters are updated under the lock of the queue and stored as relaxed atomics, so
+ * snapshot() can be called from any thread at any time without blocking the queue. The
+ * snapshot is not atomic as whole, counters can be skewed by operations running in parallel
+ *
+ * Time in the queue is measured in FIFO order, it is exact for FIFO queues. For the
+ * priority_queue it is an approximation
+ *
+ * @tparam Clock clock used to measure durations
+ */
+template<typename Clock = std::chrono::steady_clock>
+class queue_stats {
+public:
+
+    using stamp_type = typename Clock::time_point;
+
+    queue_stats() = default;
+    queue_stats(const queue_stats &) = delete;
+    queue_stats &operator=(const queue_stats &) = delete;
+
+    ///retrieve snapshot
+    queue_stats_snapshot snapshot() const {
+        queue_stats_snapshot r;
+        r.depth = _depth.load(std::memory_order_relaxed);
+        r.high_water = _high_water.load(std::memory_order_relaxed);
+        r.waiting_producers = _waiting[1].load(std::memory_order_relaxed);
+        r.waiting_consumers = _waiting[0].load(std::memory_order_relaxed);
+        r.items = _items.load(std::memory_order_relaxed);
+        copy(_item_time, r.item_time);
+        copy(_wait_time[1], r.producer_wait);
+        copy(_wait_time[0], r.consumer_wait);
+        return r;
+    }
+
+    void item_pushed() {
+        auto d = inc(_depth);
+        if (d > _high_water.load(std::memory_order_relaxed)) {
+            _high_water.store(d, std::memory_order_relaxed);
+        }
+        _stamps.push(Clock::now());
+    }
+
+    void item_popped() {
+        dec(_depth);
+        inc(_items);
+        record(_item_time, Clock::now() - _stamps.pop());
+    }
+
+    void item_handed() {
+        inc(_items);
+        record(_item_time, Clock::duration::zero());
+    }
+
+    void waiter_suspended(bool producer, stamp_type &stamp) {
+        stamp = Clock::now();
+        inc(_waiting[producer]);
+    }
+
+    void waiter_resumed(bool producer, const stamp_type &stamp) {
+        dec(_waiting[producer]);
+        record(_wait_time[producer], Clock::now() - stamp);
+    }
+
+protected:
+
+    using atomic_histogram = std::array<std::atomic<std::uint64_t>, queue_stats_snapshot::buckets>;
+
+    //time stamps of items in the queue, grows as needed
+    struct stamp_ring {
+        std::unique_ptr<stamp_type[]> _items;
+        std::size_t _mask = 0;
+        std::size_t _front = 0;
+        std::size_t _back = 0;
+
+        void push(stamp_type tp) {
+            if (_front - _back > _mask || !_items) grow();
+            _items[_front & _mask] = tp;
+            ++_front;
+        }
+        stamp_type pop() {
+            if (_front == _back) return Clock::now();
+            return _items[_back++ & _mask];
+        }
+        void grow() {
+            std::size_t cap = _items?(_mask + 1) * 2:16;
+            auto n = std::make_unique<stamp_type[]>(cap);
+            for (std::size_t i = _back; i != _front; ++i) n[i - _back] = _items[i & _mask];
+            _front -= _back;
+            _back = 0;
+            _items = std::move(n);
+            _mask = cap - 1;
+        }
+    };
+
+    //writers are serialized by the lock of the queue, so load+store is enough
+    template<typename X>
+    static X inc(std::atomic<X> &v) {
+        X r = v.load(std::memory_order_relaxed) + 1;
+        v.store(r, std::memory_order_relaxed);
+        return r;
+    }
+    template<typename X>
+    static void dec(std::atomic<X> &v) {
+        v.store(v.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+
+    static void record(atomic_histogram &h, typename Clock::duration dur) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+        auto b = ns > 0?static_cast<unsigned int>(std::bit_width(static_cast<std::uint64_t>(ns))):0U;
+        inc(h[b < h.size()?b:h.size() - 1]);
+    }
+
+    static void copy(const atomic_histogram &h, queue_stats_snapshot::histogram &out) {
+        for (std::size_t i = 0; i < h.size(); ++i) out[i] = h[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic<std::size_t> _depth = {};
+    std::atomic<std::size_t> _high_water = {};
+    //index 0 - consumers, 1 - producers
+    std::atomic<std::size_t> _waiting[2] = {};
+    std::atomic<std::uint64_t> _items = {};
+    atomic_histogram _item_time = {};
+    atomic_histogram _wait_time[2] = {};
+    stamp_ring _stamps;
+};
+
+}
@@ -4,25 +4,51 @@
 #include "basic_coro/coro_frame.hpp"
 #include "basic_coro/prepared_coro.hpp"
 #include "cancel_signal.hpp"
+#include "timing_wheel.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <mutex>
 #include <optional>
 #include <condition_variable>
 #include <queue>
+#include <span>
 #include <stop_token>
 #include <vector>
 #include <thread>
+#include <unordered_map>
 namespace coro {
 
 
+///timer queue implemented as indexed 4-ary heap
+/**
+ * The heap contains only time and index of the item, the items itself are stored in separate
+ * table, which also tracks position of each item in the heap. Identities are indexed by
+ * a hash table, so remove_by_ident() and set_time() don't need to search the heap, they
+ * are O(log n). 4-ary layout makes the heap shallower and children of a node share
+ * a cache line
+ *
+ * @tparam T type of stored item (must be default constructible)
+ * @tparam _TP time point
+ * @tparam _Ident identity of the item, used for cancellation. Default constructed identity
+ * is not indexed
+ */
 template<typename T, typename _TP, typename _Ident = const void *>
 class generic_scheduler {
 public:
 
+    ///count of children of the node
+    static constexpr std::size_t arity = 4;
+
     void schedule_at(T x, _TP timestamp, _Ident ident) {
-        _heap.push_back({timestamp, std::move(x), ident});
-        std::push_heap(_heap.begin(), _heap.end(), compare);
+        std::uint32_t idx = alloc_item();
+        Item &it = _items[idx];
+        it.res = std::move(x);
+        it.ident = ident;
+        it.pos = _heap.size();
+        _heap.push_back({timestamp, idx});
+        shift_up(_heap.size() - 1);
+        if (ident != _Ident{}) _index.emplace(ident, idx);
     }
 
     std::optional<_TP> get_first_scheduled_time() const {
@@ -31,102 +57,133 @@ public:
     }
 
     T remove_first() {
-        T out;
-        if (!_heap.empty()) {
-            std::pop_heap(_heap.begin(), _heap.end(), compare);
-            out = std::move(_heap.back().res);
-            _heap.pop_back();
-        }
-        return out;
+        if (_heap.empty()) return T{};
+        return remove_item(_heap.front().idx);
     }
+
     T remove_by_ident(_Ident ident) {
-        T r;
-        for (std::size_t i = 0, cnt = _heap.size();i<cnt; ++i) {
-            if (_heap[i].ident == ident) {
-                if (i == 0) {
-                    r = remove_first();
-                } else if (i == cnt-1) {
-                    r = std::move(_heap[i].res);
-                    _heap.pop_back();
-                } else {
-                    r = std::move(_heap[i].res);
-                    update_heap_element(i, std::move(_heap.back()));
-                    _heap.pop_back();
-                }
-                break;
-            }
-        }
-        return r;
+        auto iter = _index.find(ident);
+        if (iter == _index.end()) return T{};
+        return remove_item(iter->second);
     }
 
     ///set task time, update its position in the heap
     bool set_time(_Ident ident, _TP new_tp) {
-        bool ok = false;
-        for (std::size_t i = 0, cnt = _heap.size();i<cnt; ++i) {
-            if (_heap[i].ident == ident) {
-                auto r=std::move(_heap[i].res);
-                update_heap_element(i, {new_tp, std::move(r), ident});
-                ok = true;
-            }
+        auto rng = _index.equal_range(ident);
+        if (rng.first == rng.second) return false;
+        for (auto iter = rng.first; iter != rng.second; ++iter) {
+            std::size_t pos = _items[iter->second].pos;
+            _heap[pos].timestamp = new_tp;
+            update(pos);
         }
-        return ok;
+        return true;
     }
 
     bool empty() const {
         return _heap.empty();
     }
 
+    ///retrieve count of scheduled items
+    std::size_t size() const {
+        return _heap.size();
+    }
+
 protected:
 
     struct HeapItem {
         _TP timestamp;
-        T res;
-        _Ident ident;
+        std::uint32_t idx;
     };
 
-    static bool compare(const HeapItem &a,const HeapItem &b) {
-        return a.timestamp > b.timestamp;
-    }
-
-    std::vector<HeapItem> _heap;
+    struct Item {
+        T res = {};
+        _Ident ident = {};
+        //position in the heap, or next free item
+        std::size_t pos = 0;
+    };
 
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
 
-    void update_heap_element(std::size_t pos, HeapItem &&new_value) {
-        bool shift_up = compare(_heap[pos], new_value);
-        _heap[pos] = std::move(new_value);
+    std::vector<HeapItem> _heap;
+    std::vector<Item> _items;
+    std::uint32_t _free = npos;
+    std::unordered_multimap<_Ident, std::uint32_t> _index;
+
+    std::uint32_t alloc_item() {
+        if (_free != npos) {
+            std::uint32_t idx = _free;
+            _free = static_cast<std::uint32_t>(_items[idx].pos);
+            return idx;
+        }
+        _items.emplace_back();
+        return static_cast<std::uint32_t>(_items.size() - 1);
+    }
 
-        if (shift_up) {
-            while (pos > 0) {
-                size_t parent = (pos - 1) / 2;
-                if (compare(_heap[parent], _heap[pos])) {
-                    std::swap(_heap[parent], _heap[pos]);
-                    pos = parent;
-                } else {
+    T remove_item(std::uint32_t idx) {
+        Item &it = _items[idx];
+        std::size_t pos = it.pos;
+        if (it.ident != _Ident{}) {
+            auto rng = _index.equal_range(it.ident);
+            for (auto iter = rng.first; iter != rng.second; ++iter) {
+                if (iter->second == idx) {
+                    _index.erase(iter);
                     break;
                 }
             }
         }
-        else {
-            size_t n = _heap.size();
-            while (true) {
-                size_t left = 2 * pos + 1;
-                size_t right = 2 * pos + 2;
-                size_t largest = pos;
-
-                if (left < n && compare(_heap[largest], _heap[left])) {
-                    largest = left;
-                }
-                if (right < n && compare(_heap[largest], _heap[right])) {
-                    largest = right;
-                }
-                if (largest != pos) {
-                    std::swap(_heap[pos], _heap[largest]);
-                    pos = largest;
-                } else {
-                    break;
-                }
+        std::size_t last = _heap.size() - 1;
+        if (pos != last) {
+            place(pos, _heap[last]);
+            _heap.pop_back();
+            update(pos);
+        } else {
+            _heap.pop_back();
+        }
+        T r = std::move(it.res);
+        it.res = T{};
+        it.ident = _Ident{};
+        it.pos = _free;
+        _free = idx;
+        return r;
+    }
+
+    void place(std::size_t pos, const HeapItem &hi) {
+        _heap[pos] = hi;
+        _items[hi.idx].pos = pos;
+    }
+
+    void update(std::size_t pos) {
+        if (pos > 0 && _heap[pos].timestamp < _heap[(pos - 1) / arity].timestamp) shift_up(pos);
+        else shift_down(pos);
+    }
+
+    void shift_up(std::size_t pos) {
+        HeapItem hi = _heap[pos];
+        while (pos > 0) {
+            std::size_t parent = (pos - 1) / arity;
+            if (!(hi.timestamp < _heap[parent].timestamp)) break;
+            place(pos, _heap[parent]);
+            pos = parent;
+        }
+        place(pos, hi);
+    }
+
+    void shift_down(std::size_t pos) {
+        HeapItem hi = _heap[pos];
+        std::size_t n = _heap.size();
+        while (true) {
+            std::size_t first = pos * arity + 1;
+            if (first >= n) break;
+            std::size_t end = std::min(first + arity, n);
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < end; ++c) {
+                if (_heap[c].timestamp < _heap[best].timestamp) best = c;
             }
+            if (!(_heap[best].timestamp < hi.timestamp)) break;
+            place(pos, _heap[best]);
+            pos = best;
         }
+        place(pos, hi);
     }
 };
 
@@ -138,14 +195,26 @@ protected:
  * @note no lock is used in this scheduler, so it is not thread safe.
  *
  * @tparam _TP time point type. Must support addition with duration and comparison operators
- * @tparam result_object type of the result object returned by the scheduler    
+ * @tparam _TimerQueue implementation of the timer queue - generic_scheduler (binary heap)
+ * or timing_wheel
  */
-template<typename _TP = std::chrono::system_clock::time_point>
+template<typename _TP = std::chrono::system_clock::time_point,
+        template<typename, typename, typename> class _TimerQueue = generic_scheduler>
 class manual_scheduler {
 public:
 
     using result_object = typename awaitable<bool>::result;
 
+    manual_scheduler() = default;
+
+    ///construct scheduler, pass arguments to the timer queue
+    /**
+     * @param args arguments of the timer queue (for example resolution of the timing_wheel)
+     */
+    template<typename ... Args>
+    requires(sizeof...(Args) > 0 && std::is_constructible_v<_TimerQueue<result_object, _TP, cancel_signal *>, Args...>)
+    explicit manual_scheduler(Args && ... args):_sch(std::forward<Args>(args)...) {}
+
     awaitable<bool> sleep_until(_TP tp, cancel_signal *cflag = nullptr) {
         return [this,tp=std::move(tp),cflag](result_object r) mutable -> prepared_coro {
             if (cflag && *cflag) return r(false);
@@ -160,7 +229,7 @@ public:
         return sleep_until(get_current_time()+dur, csignal);
     }
     ///retrive first scheduled time
-    std::optional<std::chrono::system_clock::time_point> get_first_scheduled_time() const {
+    std::optional<_TP> get_first_scheduled_time() const {
         return _sch.get_first_scheduled_time();
     }
     ///remove first scheduled coroutine
@@ -211,7 +280,7 @@ public:
 
 protected:
     _TP _current_time = {};
-    generic_scheduler<result_object, std::chrono::system_clock::time_point, cancel_signal *> _sch;
+    _TimerQueue<result_object, _TP, cancel_signal *> _sch;
 };
 
 
@@ -219,11 +288,30 @@ protected:
 /**
     co_await operation on the scheduler return true if the sleep was waken up by timeout, and false if sleep was interrupted.
     You can also cancel sleep by identity, or send alert to alertable sleeping coroutine.
+
+    @tparam _TimerQueue implementation of the timer queue - generic_scheduler (indexed heap, default)
+    or timing_wheel (O(1) insert and cancel, suitable for large count of timeouts)
+    @tparam _Clock clock used to measure time. Default is steady_clock, which is not affected by
+    adjustments of the system time. Time points of other clocks are converted relatively to current time
 */
-class scheduler {
+template<template<typename, typename, typename> class _TimerQueue = generic_scheduler,
+        typename _Clock = std::chrono::steady_clock>
+class basic_scheduler {
 public:
 
     using result_object = typename awaitable<bool>::result;
+    using clock = _Clock;
+    using time_point = typename _Clock::time_point;
+
+    basic_scheduler() = default;
+
+    ///construct scheduler, pass arguments to the timer queue
+    /**
+     * @param args arguments of the timer queue (for example resolution of the timing_wheel)
+     */
+    template<typename ... Args>
+    requires(sizeof...(Args) > 0 && std::is_constructible_v<_TimerQueue<result_object, time_point, cancel_signal *>, Args...>)
+    explicit basic_scheduler(Args && ... args):_sch(std::forward<Args>(args)...) {}
 
     ///sleep until given time point, with optional cancel signal
      /**
@@ -234,7 +322,7 @@ public:
         @return awaitable object, which can be co_awaited. When co_awaited, it returns true if sleep was waken up by timeout,
             and false if sleep was interrupted by cancel signal.
       */
-    awaitable<bool> sleep_until(std::chrono::system_clock::time_point tp, cancel_signal *cflag = nullptr) {
+    awaitable<bool> sleep_until(time_point tp, cancel_signal *cflag = nullptr) {
         return [this,tp=std::move(tp),cflag](result_object r) mutable -> prepared_coro {
             std::scoped_lock _(_mx);            
             if (cflag && *cflag) return r(false);
@@ -244,6 +332,17 @@ public:
         };
     }
 
+    ///sleep until time point of other clock (for example system_clock)
+    /**
+     * The time point is converted to the clock of the scheduler relatively to current time. Later
+     * adjustments of the other clock are not reflected
+     */
+    template<typename _OtherClock, typename _Dur>
+    requires(!std::is_same_v<_OtherClock, _Clock>)
+    awaitable<bool> sleep_until(std::chrono::time_point<_OtherClock, _Dur> tp, cancel_signal *cflag = nullptr) {
+        return sleep_until(_Clock::now() + std::chrono::ceil<typename _Clock::duration>(tp - _OtherClock::now()), cflag);
+    }
+
     ///sleep for given duration, with optional cancel signal
      /**
       * @param dur duration to sleep
@@ -255,7 +354,7 @@ public:
       */
     template<typename A, typename B>
     awaitable<bool> sleep_for(std::chrono::duration<A, B> dur, cancel_signal *cflag = nullptr) {
-        return sleep_until(std::chrono::system_clock::now() + dur, cflag);
+        return sleep_until(_Clock::now() + std::chrono::ceil<typename _Clock::duration>(dur), cflag);
     }   
 
     ///run thread and execute scheduled coroutines in this thread
@@ -264,29 +363,41 @@ public:
            which takes result object of scheduled coroutine as an argument and executes it.  It allows
            to forward execution of scheduled coroutine to other thread, or to execute it in the same thread.
            If you want to execute scheduled coroutines in the same thread, you can use run_thread() without arguments, 
-           which is equivalent to run_thread([](auto &&){})
+           which is equivalent to run_thread([](auto &&){}). If the executor is batch_executor,
+           all coroutines expired at the same time are passed in one call (batch mode)
       * @param tkn stop token to stop thread. When stop is requested, thread is stopped and all scheduled coroutines are not executed. 
+      *
+      * All expired coroutines are removed under single lock and with single reading of the clock
       */
-    template<std::invocable<prepared_coro> Executor>
+    template<scheduler_executor Executor>
     void run_thread(Executor &&executor, std::stop_token tkn) {
         std::stop_callback __(tkn,[this]{
             _cv.notify_all();
         });
+        std::vector<result_object> expired;
+        std::vector<prepared_coro> batch;
         while (!tkn.stop_requested()) {
-            std::unique_lock lk(_mx);
-            auto tm = _sch.get_first_scheduled_time();
-            if (tm) {
-                auto now =std::chrono::system_clock::now();
-                if (now > *tm) {
-                    auto r = _sch.remove_first();
-                    lk.unlock();
-                    executor(r(true));
-                } else{
+            {
+                std::unique_lock lk(_mx);
+                auto tm = _sch.get_first_scheduled_time();
+                if (!tm) {
+                    _cv.wait(lk);
+                    continue;
+                }
+                auto now = _Clock::now();
+                if (now < *tm) {
                     _cv.wait_until(lk, *tm);
+                    continue;
                 }
-            } else {
-                _cv.wait(lk);
+                do {
+                    expired.push_back(_sch.remove_first());
+                    tm = _sch.get_first_scheduled_time();
+                } while (tm && *tm <= now);
             }
+            for (auto &r: expired) batch.push_back(r(true));
+            expired.clear();
+            execute_batch(executor, std::span<prepared_coro>(batch));
+            batch.clear();
         }
     }
     ///run thread and execute scheduled coroutines in this thread
@@ -339,7 +450,7 @@ public:
      * @param executor executor (see run_thread)
      * @return running thread. Ensure that you destroy thread before destuction of scheduler
      */
-    template<std::invocable<result_object> Executor>
+    template<scheduler_executor Executor>
     std::jthread create_thread(Executor executor) {
         return std::jthread([this,executor = std::move(executor)]
                              (std::stop_token tkn)mutable{
@@ -371,8 +482,11 @@ public:
 protected:
     mutable std::mutex _mx;
     std::condition_variable _cv;
-    generic_scheduler<result_object, std::chrono::system_clock::time_point,cancel_signal *> _sch;
+    _TimerQueue<result_object, time_point, cancel_signal *> _sch;
 };
 
+///scheduler with indexed heap timer queue and steady_clock
+using scheduler = basic_scheduler<>;
+
 
 }
@@ -0,0 +1,287 @@
+#pragma once
+#include "awaitable.hpp"
+#include "await_proxy.hpp"
+#include "cancel_signal.hpp"
+#include "claim_token.hpp"
+#include "coro_frame.hpp"
+#include <atomic>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace coro {
+
+///a case of the select()
+/**
+ * - value_type - type of value received, when the case wins
+ * - arm(claim_token) - returns awaitable which registers the case. The case must claim
+ *   the token before it resolves the awaitable with a value. If the claim fails, the
+ *   case resolves the awaitable without value (or leaves it pending until disarm())
+ * - disarm() - withdraws the case, pending awaitable must be resolved (now or later)
+ */
+template<typename T>
+concept select_case = requires(T &c, claim_token tkn) {
+    typename T::value_type;
+    {c.arm(tkn)} -> std::same_as<awaitable<typename T::value_type> >;
+    {c.disarm()} -> std::same_as<prepared_coro>;
+};
+
+
+///case of select() which completes after a timeout
+/**
+ * @tparam Scheduler scheduler (scheduler, manual_scheduler)
+ * @tparam Dur duration or time point
+ *
+ * The timer is armed only if no earlier case of the select() won during arming. The
+ * value received is always true
+ */
+template<typename Scheduler, typename Dur>
+class sleep_case: public coro_frame<sleep_case<Scheduler, Dur> > {
+public:
+    using value_type = bool;
+
+    ///construct the case
+    /**
+     * @param sch scheduler
+     * @param dur timeout, it starts when the case is armed. If time point is
+     * passed, it sleeps until the time point
+     */
+    sleep_case(Scheduler &sch, Dur dur):_sch(&sch),_dur(dur) {}
+    sleep_case(sleep_case &&other):_sch(other._sch),_dur(other._dur) {}
+
+    awaitable<bool> arm(claim_token tkn) {
+        return [this, tkn](awaitable<bool>::result r) -> prepared_coro {
+            _tkn = tkn;
+            _r = std::move(r);
+            if constexpr(requires(Scheduler &sch, Dur dur, cancel_signal *sig){sch.sleep_for(dur, sig);}) {
+                _sleep = _sch->sleep_for(_dur, &_sig);
+            } else {
+                _sleep = _sch->sleep_until(_dur, &_sig);
+            }
+            if (_sleep.await_ready()) return do_resume();
+            return call_await_suspend(_sleep, this->create_handle());
+        };
+    }
+
+    prepared_coro disarm() {
+        return _sch->cancel(&_sig);
+    }
+
+protected:
+    Scheduler *_sch;
+    Dur _dur;
+    cancel_signal _sig;
+    claim_token _tkn;
+    awaitable<bool> _sleep = std::nullopt;
+    awaitable<bool>::result _r;
+
+    prepared_coro do_resume() {
+        bool fired = _sleep.has_value() && *_sleep;
+        if (fired && _tkn.claim()) return _r(true);
+        return (_r = std::nullopt);
+    }
+
+    friend coro_frame<sleep_case>;
+};
+
+
+///Await the first ready of multiple cases
+/**
+ * @code
+ * auto r = co_await coro::select(data.pop_case(), ctrl.pop_case(), coro::sleep_case(sch, 100ms));
+ * switch (r.index()) {
+ *      case 0: process(std::get<0>(r)); break;
+ *      case 1: control(std::get<1>(r)); break;
+ *      default: timeout(); break;
+ * }
+ * @endcode
+ *
+ * Cases are armed in order. Once a case wins, the remaining cases are not armed and
+ * armed cases are withdrawn. No value is consumed by a case which didn't win. The awaiting
+ * coroutine is resumed after all armed cases are withdrawn, so the object can be
+ * destroyed right after co_await.
+ *
+ * @tparam Cases list of cases (queue::pop_case(), sleep_case)
+ *
+ * @note if the winning case is resolved without value (closed queue), co_await throws
+ * await_canceled_exception
+ */
+template<select_case ... Cases>
+class select {
+public:
+
+    ///result - variant, where index is index of the winning case
+    using value_type = std::variant<typename Cases::value_type...>;
+
+    ///construct the object
+    /**
+     * @param cases list of cases
+     */
+    select(Cases ... cases):_cases(std::move(cases)...) {}
+
+    select(const select &) = delete;
+    select &operator=(const select &) = delete;
+
+    bool await_ready() const {return false;}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        _h = h;
+        arm_cases(std::index_sequence_for<Cases...>{});
+        if (_flags.fetch_or(flag_armed, std::memory_order_acq_rel) & flag_won) {
+            disarm_cases(std::index_sequence_for<Cases...>{});
+        }
+        return _refs.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    value_type await_resume() {
+        return get_result(std::index_sequence_for<Cases...>{});
+    }
+
+
+protected:
+
+    static constexpr unsigned int flag_armed = 1;
+    static constexpr unsigned int flag_won = 2;
+
+    template<typename Case>
+    struct holder: coro_frame<holder<Case> > {
+        Case _case;
+        awaitable<typename Case::value_type> _awt = std::nullopt;
+        select *_owner = nullptr;
+        unsigned int _id = 0;
+
+        holder(Case &&c):_case(std::move(c)) {}
+
+        prepared_coro do_resume() {
+            return _owner->resolved(_id);
+        }
+    };
+
+    std::tuple<holder<Cases>...> _cases;
+    //id of winner (index + 1)
+    std::atomic<unsigned int> _winner = {};
+    //pending cases + 1 during arming
+    std::atomic<unsigned int> _refs = {1};
+    std::atomic<unsigned int> _flags = {};
+    std::coroutine_handle<> _h;
+
+    template<std::size_t ... Idx>
+    void arm_cases(std::index_sequence<Idx...>) {
+        (arm_case(std::get<Idx>(_cases), Idx + 1),...);
+    }
+
+    template<typename Case>
+    void arm_case(holder<Case> &hld, unsigned int id) {
+        if (_winner.load(std::memory_order_acquire)) return;
+        hld._owner = this;
+        hld._id = id;
+        _refs.fetch_add(1, std::memory_order_relaxed);
+        hld._awt = hld._case.arm(claim_token(_winner, id));
+        if (hld._awt.await_ready()) {
+            resolved(id);
+        } else {
+            call_await_suspend(hld._awt, hld.create_handle());
+        }
+    }
+
+    template<std::size_t ... Idx>
+    void disarm_cases(std::index_sequence<Idx...>) {
+        unsigned int w = _winner.load(std::memory_order_acquire);
+        (disarm_case(std::get<Idx>(_cases), w),...);
+    }
+
+    template<typename Case>
+    static void disarm_case(holder<Case> &hld, unsigned int winner) {
+        if (hld._id && hld._id != winner) hld._case.disarm();
+    }
+
+    //called when a case is resolved
+    prepared_coro resolved(unsigned int id) {
+        if (_winner.load(std::memory_order_acquire) == id) {
+            //the winner holds its reference, so the object can't be released during disarm
+            if (_flags.fetch_or(flag_won, std::memory_order_acq_rel) & flag_armed) {
+                disarm_cases(std::index_sequence_for<Cases...>{});
+            }
+        }
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) return prepared_coro(_h);
+        return {};
+    }
+
+    template<std::size_t ... Idx>
+    value_type get_result(std::index_sequence<Idx...>) {
+        unsigned int w = _winner.load(std::memory_order_acquire);
+        std::optional<value_type> r;
+        ((w == Idx + 1 ? (void)r.emplace(std::in_place_index<Idx>, std::move(std::get<Idx>(_cases)._awt).value()) : (void)0),...);
+        if (!r) throw await_canceled_exception();
+        return std::move(*r);
+    }
+};
+
+
+///callback which runs a case of select() with a timeout
+/**
+ * It is used to implement operations with a timeout (queue::pop_for(), mutex::lock_for()). The
+ * case is armed before the timer, so if the case completes immediately, no timer is armed.
+ *
+ * @tparam T type of result
+ * @tparam Case the case
+ * @tparam Scheduler scheduler
+ * @tparam Timeout duration or time point
+ * @tparam Fn stateless function which receives the result object and the value of select(). It
+ * must resolve the result. If the case is resolved without value, the result is resolved without
+ * value too.
+ */
+template<typename T, select_case Case, typename Scheduler, typename Timeout, typename Fn>
+class timeout_cb: public coro_frame<timeout_cb<T, Case, Scheduler, Timeout, Fn> > {
+public:
+
+    timeout_cb(Case c, Scheduler &sch, Timeout tm, Fn fn)
+        :_case(std::move(c)),_sch(&sch),_tm(tm),_fn(fn) {}
+    timeout_cb(timeout_cb &&other)
+        :_case(std::move(other._case)),_sch(other._sch),_tm(other._tm),_fn(other._fn) {}
+
+    prepared_coro operator()(typename awaitable<T>::result r) {
+        if (!r) return {};
+        _r = std::move(r);
+        _sel.emplace(std::move(_case), sleep_case<Scheduler, Timeout>(*_sch, _tm));
+        return call_await_suspend(*_sel, this->create_handle());
+    }
+
+protected:
+    using select_type = select<Case, sleep_case<Scheduler, Timeout> >;
+
+    Case _case;
+    Scheduler *_sch;
+    Timeout _tm;
+    Fn _fn;
+    typename awaitable<T>::result _r;
+    std::optional<select_type> _sel;
+
+    prepared_coro do_resume() {
+        //this object is destroyed when the result is resolved
+        auto r = std::move(_r);
+        Fn fn = _fn;
+        std::optional<typename select_type::value_type> v;
+        try {
+            v.emplace(_sel->await_resume());
+        } catch (const await_canceled_exception &) {
+            return (r = std::nullopt);
+        } catch (...) {
+            return r(std::current_exception());
+        }
+        return fn(std::move(r), std::move(*v));
+    }
+
+    friend coro_frame<timeout_cb>;
+};
+
+///create awaitable which runs a case of select() with a timeout
+/**
+ * @see timeout_cb
+ */
+template<typename T, select_case Case, typename Scheduler, typename Timeout, typename Fn>
+awaitable<T> with_timeout(Case c, Scheduler &sch, Timeout tm, Fn fn) {
+    return timeout_cb<T, Case, Scheduler, Timeout, Fn>(std::move(c), sch, tm, fn);
+}
+
+}
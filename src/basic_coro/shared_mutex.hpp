@@ -0,0 +1,277 @@
+#pragma once
+#include "awaitable.hpp"
+#include "coro_frame.hpp"
+#include <atomic>
+
+namespace coro {
+
+///implements reader/writer mutex for coroutines
+/**
+ * The mutex can be held exclusively (lock()) or shared (lock_shared()) across co_await and
+ * across multiple threads. It uses the same lock-free request stack as the mutex.
+ *
+ * @code
+ * auto own = co_await mx.lock_shared();
+ * read(table);
+ * own.release();
+ * @endcode
+ *
+ * Writer preference: once a writer is waiting, new readers are queued behind it. When
+ * the lock is passed to readers, all readers at the head of the queue (including requests
+ * arrived during the writer's ownership) are granted in one pass and resumed by
+ * the releasing thread one by one.
+ */
+class shared_mutex {
+public:
+
+    ///ownership object - carries exclusive or shared ownership of the locked mutex
+    /**
+     * @tparam exclusive true for exclusive ownership, false for shared ownership
+     */
+    template<bool exclusive>
+    class basic_ownership {
+    public:
+        ///default construct not owned
+        basic_ownership() = default;
+        ///you can move
+        basic_ownership(basic_ownership &&other):_owning(std::exchange(other._owning, nullptr)) {}
+        ///you can move by assignment
+        basic_ownership &operator=(basic_ownership &&other) {
+            if (this != &other) {
+                release();
+                _owning = std::exchange(other._owning, nullptr);
+            }
+            return *this;
+        }
+        ///release ownership prematurely
+        /**
+         * @return prepared coroutine which received ownership (if any). You can schedule its resumption
+         */
+        prepared_coro release() {
+            auto p = std::exchange(_owning, nullptr);
+            if (p) {
+                if constexpr(exclusive) return p->unlock();
+                else return p->unlock_shared();
+            }
+            return {};
+        }
+        ///destructor releases ownership
+        ~basic_ownership() {
+            release();
+        }
+
+        ///determine state
+        bool owns_lock() const {return _owning != nullptr;}
+
+        ///determine state
+        explicit operator bool() const {return _owning != nullptr;}
+    protected:
+        basic_ownership(shared_mutex *own):_owning(own) {}
+        shared_mutex *_owning = nullptr;
+
+        friend class shared_mutex;
+    };
+
+    ///exclusive ownership
+    using ownership = basic_ownership<true>;
+    ///shared ownership
+    using shared_ownership = basic_ownership<false>;
+
+    shared_mutex() = default;
+    shared_mutex(const shared_mutex &) = delete;
+    shared_mutex &operator=(const shared_mutex &) = delete;
+
+    ///try to lock exclusively without waiting
+    /**
+     * @return ownership object either owning lock, or not owning lock
+     */
+    ownership try_lock() {
+        slot *need = nullptr;
+        if (_requests.compare_exchange_strong(need, get_doorman())) return this;
+        return {};
+    }
+
+    ///try to lock shared without waiting
+    /**
+     * Succeeds if the mutex is unlocked, or it is held by readers and no writer is waiting
+     *
+     * @return ownership object either owning lock, or not owning lock
+     */
+    shared_ownership try_lock_shared() {
+        std::size_t w = _readers.load(std::memory_order_acquire);
+        while (w >= reader_unit && !(w & writer_waiting) && _requests.load(std::memory_order_acquire) == get_doorman()) {
+            if (_readers.compare_exchange_weak(w, w + reader_unit, std::memory_order_acq_rel)) return this;
+        }
+        slot *need = nullptr;
+        if (_requests.compare_exchange_strong(need, get_doorman())) {
+            _readers.store(reader_unit, std::memory_order_release);
+            return this;
+        }
+        return {};
+    }
+
+    ///lock exclusively
+    /**
+     * @return awaitable ownership. If try_lock() succeeds, the awaitable is resolved immediately.
+     * Otherwise the request is added after co_await
+     */
+    awaitable<ownership> lock() {
+        auto test = try_lock();
+        if (test) return test;
+        return slot_cb<true>(this);
+    }
+
+    ///lock shared
+    /**
+     * @return awaitable shared ownership. If try_lock_shared() succeeds, the awaitable is resolved
+     * immediately. Otherwise the request is added after co_await
+     */
+    awaitable<shared_ownership> lock_shared() {
+        auto test = try_lock_shared();
+        if (test) return test;
+        return slot_cb<false>(this);
+    }
+
+protected:
+
+    //item of linked list of the requests and queue
+    struct slot {
+        //next item in linked list
+        slot *_next;
+        //pointer to awaitable<ownership> or awaitable<shared_ownership>
+        void *_resume;
+        //request of shared ownership
+        bool _shared;
+    };
+
+    template<bool exclusive>
+    struct slot_cb: slot {
+        shared_mutex *_me;
+        slot_cb(shared_mutex *me):slot{nullptr, nullptr, !exclusive},_me(me) {}
+        prepared_coro operator()(typename awaitable<basic_ownership<exclusive> >::result r) {
+            if (!r) return {};
+            this->_next = nullptr;
+            this->_resume = r.release();
+            return _me->add_request(this);
+        }
+    };
+
+    //resumes chain of granted readers
+    struct wake_frame: coro_frame<wake_frame> {
+        shared_mutex *_me;
+        wake_frame(shared_mutex *me):_me(me) {}
+
+        //chain is read before first reader is resumed, no other batch can be granted
+        //until all readers of this batch are resumed and released
+        void do_resume() {
+            slot *s = std::exchange(_me->_wake_chain, nullptr);
+            while (s) {
+                slot *n = s->_next;
+                _me->resume_slot(s).resume();
+                s = n;
+            }
+        }
+        void do_destroy() {
+            do_resume();
+        }
+    };
+
+    static constexpr std::size_t writer_waiting = 1;
+    static constexpr std::size_t reader_unit = 2;
+    constexpr static slot doorman = {};
+
+    //stack of requests - added between unlocks
+    std::atomic<slot *> _requests = {};
+    //count of active readers (x reader_unit) | writer_waiting
+    std::atomic<std::size_t> _readers = {};
+    //queue of requests - processed during unlocks
+    slot *_queue = {};
+    //readers granted in last batch
+    slot *_wake_chain = {};
+    wake_frame _wake{this};
+
+    slot *get_doorman() {return const_cast<slot *>(&doorman);}
+
+    //add slot to request stack
+    prepared_coro add_request(slot *s) {
+        slot *top = s->_next;
+        while (!_requests.compare_exchange_strong(top, s)) s->_next = top;
+        if (top == nullptr) {
+            //mutex was unlocked, we own it - queue other requests behind this one
+            make_queue(_requests.exchange(get_doorman()), s);
+            s->_next = _queue;
+            _queue = s;
+            return dispatch();
+        }
+        return {};
+    }
+
+    //converts stack oriented linked list to queue
+    void make_queue(slot *from, slot *to) {
+        while (from != to) {
+            auto n = from->_next;
+            from->_next = _queue;
+            _queue = from;
+            from = n;
+        }
+    }
+
+    prepared_coro resume_slot(slot *s) {
+        if (s->_shared) {
+            awaitable<shared_ownership>::result r(static_cast<awaitable<shared_ownership> *>(s->_resume));
+            return r(shared_ownership(this));
+        } else {
+            awaitable<ownership>::result r(static_cast<awaitable<ownership> *>(s->_resume));
+            return r(ownership(this));
+        }
+    }
+
+    //passes the free mutex to the next request(s)
+    prepared_coro dispatch() {
+        if (!_queue) {
+            slot *need = get_doorman();
+            if (_requests.compare_exchange_strong(need, nullptr)) return {};
+            make_queue(_requests.exchange(get_doorman()), get_doorman());
+        }
+        slot *f = _queue;
+        if (!f->_shared) {
+            _queue = f->_next;
+            return resume_slot(f);
+        }
+        //grant all readers at head of the queue, including new requests
+        slot *chain = nullptr;
+        slot **tail = &chain;
+        std::size_t cnt = 0;
+        while (true) {
+            while (_queue && _queue->_shared) {
+                f = _queue;
+                _queue = f->_next;
+                *tail = f;
+                tail = &f->_next;
+                ++cnt;
+            }
+            if (_queue) break;
+            slot *top = _requests.exchange(get_doorman());
+            if (top == get_doorman()) break;
+            make_queue(top, get_doorman());
+        }
+        *tail = nullptr;
+        _readers.store(cnt * reader_unit | (_queue?writer_waiting:0), std::memory_order_release);
+        if (cnt == 1) return resume_slot(chain);
+        _wake_chain = chain;
+        return prepared_coro(_wake.create_handle());
+    }
+
+    prepared_coro unlock() {
+        return dispatch();
+    }
+
+    prepared_coro unlock_shared() {
+        if (_readers.fetch_sub(reader_unit, std::memory_order_acq_rel) >= 2 * reader_unit) return {};
+        //last reader - clear writer_waiting flag and pass the mutex
+        _readers.store(0, std::memory_order_relaxed);
+        return dispatch();
+    }
+};
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "mpmc_queue.hpp"
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace coro {
+
+///bounded single-producer single-consumer ring
+/**
+ * The producer owns the push position, the consumer owns the pop position. Each
+ * side keeps a cached copy of the opposite position, so the shared cache line is read
+ * only when the cached value says the ring is full or empty.
+ *
+ * @tparam T type of item
+ * @tparam count capacity of the ring, must be power of two
+ *
+ * @note try_push() can be called by one producer at time, try_pop() by one consumer
+ * at time. basic_queue calls them under its lock only when the opposite side is suspended,
+ * so one producer coroutine and one consumer coroutine can be resumed by any thread
+ */
+template<typename T, unsigned int count>
+class spsc_ring {
+public:
+
+    static_assert(std::has_single_bit(count), "spsc_ring requires power of two capacity");
+
+    using value_type = T;
+
+    spsc_ring() = default;
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    ~spsc_ring() {
+        while (try_pop());
+    }
+
+    ///try to push item
+    /**
+     * @param val value to push. It is moved only if the function succeeds
+     * @retval true pushed
+     * @retval false queue is full
+     */
+    bool try_push(T &&val) {
+        return try_push_impl(std::move(val));
+    }
+
+    ///try to push item
+    bool try_push(const T &val) {
+        return try_push_impl(val);
+    }
+
+    ///try to pop item
+    /**
+     * @return item or nullopt if the queue is empty
+     */
+    std::optional<T> try_pop() {
+        std::size_t pos = _pop_pos.load(std::memory_order_relaxed);
+        if (pos == _push_cache) {
+            _push_cache = _push_pos.load(std::memory_order_acquire);
+            if (pos == _push_cache) return std::nullopt;
+        }
+        item &x = _items[pos & (count - 1)];
+        std::optional<T> r(std::move(x.val));
+        std::destroy_at(&x.val);
+        //seq_cst (exchange is cheaper than store+mfence), waiting producers are read after it
+        _pop_pos.exchange(pos + 1, std::memory_order_seq_cst);
+        return r;
+    }
+
+    ///determine whether queue is empty
+    bool is_empty() const {
+        return _push_pos.load(std::memory_order_seq_cst) == _pop_pos.load(std::memory_order_seq_cst);
+    }
+
+    ///determine whether queue is full
+    bool is_full() const {
+        std::size_t pop_pos = _pop_pos.load(std::memory_order_seq_cst);
+        return _push_pos.load(std::memory_order_seq_cst) - pop_pos >= count;
+    }
+
+protected:
+
+    struct item {
+        T val;
+        item() {}
+        ~item() {}
+    };
+
+    template<typename X>
+    bool try_push_impl(X &&val) {
+        std::size_t pos = _push_pos.load(std::memory_order_relaxed);
+        if (pos - _pop_cache >= count) {
+            _pop_cache = _pop_pos.load(std::memory_order_acquire);
+            if (pos - _pop_cache >= count) return false;
+        }
+        std::construct_at(&_items[pos & (count - 1)].val, std::forward<X>(val));
+        //seq_cst (exchange is cheaper than store+mfence), waiting consumers are read after it
+        _push_pos.exchange(pos + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    //producer side
+    alignas(64) std::atomic<std::size_t> _push_pos = {0};
+    std::size_t _pop_cache = 0;
+    //consumer side
+    alignas(64) std::atomic<std::size_t> _pop_pos = {0};
+    std::size_t _push_cache = 0;
+    alignas(64) item _items[count];
+};
+
+///Single-producer single-consumer queue
+/**
+ * Keeps awaitable push() and pop() of the basic_queue. The lock is taken only when
+ * the queue is empty or full and a coroutine needs to be suspended or resumed
+ *
+ * @tparam T type of item
+ * @tparam count capacity of the queue, must be power of two
+ * @tparam Lock lock which protects suspension of the producer and the consumer
+ */
+template<typename T, unsigned int count, basic_lockable Lock = std::mutex>
+class spsc_queue : public basic_queue<spsc_ring<T, count>, Lock> {};
+
+}
@@ -0,0 +1,436 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "pending.hpp"
+#include "prepared_coro.hpp"
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace coro {
+
+///work-stealing deque (Chase-Lev) of coroutine handles
+/**
+ * The owner thread pushes and pops handles at the bottom (LIFO), other threads
+ * steal handles from the top (FIFO). Push and pop are wait-free for the owner, steal
+ * is lock-free.
+ *
+ * The deque grows when it is full. Replaced buffers are kept until the deque is
+ * destroyed, because a thief can still read from them.
+ *
+ * @note push() and pop() can be called only by the owner thread. steal(), empty() and size()
+ * can be called from any thread
+ */
+class work_stealing_deque {
+public:
+
+    ///construct deque
+    /**
+     * @param capacity initial capacity, rounded up to power of two
+     */
+    explicit work_stealing_deque(std::size_t capacity = 256) {
+        std::size_t sz = 1;
+        while (sz < capacity) sz <<= 1;
+        _rings.push_back(std::make_unique<ring>(sz));
+        _ring.store(_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    work_stealing_deque(const work_stealing_deque &) = delete;
+    work_stealing_deque &operator=(const work_stealing_deque &) = delete;
+
+    ///push handle at the bottom (owner only)
+    void push(std::coroutine_handle<> h) {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed);
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        ring *r = _ring.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(r->mask)) r = grow(r, t, b);
+        r->store(b, h.address());
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    ///pop handle from the bottom (owner only)
+    /**
+     * @return handle, or empty handle if the deque is empty
+     */
+    std::coroutine_handle<> pop() {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        ring *r = _ring.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return {};
+        }
+        void *x = r->load(b);
+        if (t == b) {
+            //last item, race with thieves
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                x = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return to_handle(x);
+    }
+
+    ///steal handle from the top (any thread)
+    /**
+     * @return handle, or empty handle if the deque is empty or another thread won the race
+     */
+    std::coroutine_handle<> steal() {
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) return {};
+        ring *r = _ring.load(std::memory_order_acquire);
+        void *x = r->load(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return {};
+        }
+        return to_handle(x);
+    }
+
+    ///test whether deque is empty (approximate when called concurrently)
+    bool empty() const {
+        return size() == 0;
+    }
+
+    ///retrieve count of handles (approximate when called concurrently)
+    std::size_t size() const {
+        std::int64_t b = _bottom.load(std::memory_order_seq_cst);
+        std::int64_t t = _top.load(std::memory_order_seq_cst);
+        return b > t?static_cast<std::size_t>(b - t):0;
+    }
+
+protected:
+
+    struct ring {
+        std::size_t mask;
+        std::unique_ptr<std::atomic<void *>[]> items;
+        explicit ring(std::size_t sz):mask(sz - 1), items(std::make_unique<std::atomic<void *>[]>(sz)) {}
+        void *load(std::int64_t idx) const {
+            return items[static_cast<std::size_t>(idx) & mask].load(std::memory_order_relaxed);
+        }
+        void store(std::int64_t idx, void *x) {
+            items[static_cast<std::size_t>(idx) & mask].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(64) std::atomic<std::int64_t> _top = {0};
+    alignas(64) std::atomic<std::int64_t> _bottom = {0};
+    std::atomic<ring *> _ring;
+    //all allocated rings, old rings are kept while thieves can read them
+    std::vector<std::unique_ptr<ring> > _rings;
+
+    ring *grow(ring *r, std::int64_t t, std::int64_t b) {
+        auto nr = std::make_unique<ring>((r->mask + 1) * 2);
+        for (std::int64_t i = t; i < b; ++i) nr->store(i, r->load(i));
+        ring *out = nr.get();
+        _rings.push_back(std::move(nr));
+        _ring.store(out, std::memory_order_release);
+        return out;
+    }
+
+    static std::coroutine_handle<> to_handle(void *x) {
+        if (x) return std::coroutine_handle<>::from_address(x);
+        return {};
+    }
+};
+
+///multi-core work-stealing executor
+/**
+ * The pool runs fixed count of worker threads. Each worker has its own work_stealing_deque.
+ * When a coroutine is enqueued from a worker thread of the pool, it is pushed to the
+ * deque of that worker (local enqueue). When it is enqueued from other thread, it is
+ * injected into shared injection queue (remote enqueue). Idle workers steal work from
+ * other workers. A worker which has nothing to do spins for a short while and then it is
+ * parked (std::atomic::wait)
+ *
+ * The pool is an executor - it can be passed to every function which accepts an executor
+ *
+ * @code
+ * coro::thread_pool pool(8);
+ * auto p = my_coroutine().launch(pool);         //start in the pool
+ * int r = co_await p;
+ *
+ * sch.run_thread(pool, tkn);                     //scheduler resumes sleepers in the pool
+ * auto thr = sch.create_thread(pool.get_executor());
+ *
+ * coroutine<void> foo() {
+ *      co_await coro::resume_on(pool);          //continue in the pool
+ * }
+ * @endcode
+ *
+ * @note the pool must not be destroyed by its own worker thread. Coroutines which
+ * remain enqueued during destruction are resumed by the thread which destroys the pool.
+ */
+class thread_pool {
+public:
+
+    ///accepts batches (see batch_executor)
+    using batch_executor_tag = void;
+
+    ///copyable executor, which enqueues coroutines to the pool
+    class executor_type {
+    public:
+        ///accepts batches (see batch_executor)
+        using batch_executor_tag = void;
+        executor_type(thread_pool &pool):_pool(&pool) {}
+        void operator()(prepared_coro coro) const {_pool->enqueue(std::move(coro));}
+        void operator()(std::span<prepared_coro> batch) const {(*_pool)(batch);}
+    protected:
+        thread_pool *_pool;
+    };
+
+    ///awaiter which moves the coroutine to a worker of the pool
+    class resume_awaiter {
+    public:
+        resume_awaiter(thread_pool &pool):_pool(pool) {}
+        ///already running in a worker of the pool
+        bool await_ready() const noexcept {return _pool.is_current();}
+        void await_suspend(std::coroutine_handle<> h) {_pool.enqueue(prepared_coro(h));}
+        static constexpr void await_resume() noexcept {}
+    protected:
+        thread_pool &_pool;
+    };
+
+    ///count of iterations spent by searching a task before the worker is parked
+    static constexpr unsigned int spin_count = 64;
+
+    ///start the pool
+    /**
+     * @param threads count of worker threads. If zero is passed, one thread is started
+     */
+    explicit thread_pool(unsigned int threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) threads = 1;
+        _workers.reserve(threads);
+        for (unsigned int i = 0; i < threads; ++i) {
+            _workers.push_back(std::make_unique<worker>(this));
+        }
+        for (auto &w: _workers) {
+            w->thr = std::thread([this, wp = w.get()]{worker_main(*wp);});
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    ///stop the pool, join all threads
+    ~thread_pool() {
+        assert(!is_current()); //destroying pool from its own thread
+        _stop.store(true, std::memory_order_seq_cst);
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_all();
+        for (auto &w: _workers) w->thr.join();
+        //resume what is remaining (it can enqueue more, which goes to the injection queue)
+        while (true) {
+            std::coroutine_handle<> h = pop_injected();
+            for (auto iter = _workers.begin(); !h && iter != _workers.end(); ++iter) {
+                h = (*iter)->deque.pop();
+            }
+            if (!h) break;
+            h.resume();
+        }
+    }
+
+    ///enqueue a coroutine
+    /**
+     * @param coro coroutine to resume in the pool. If called from a worker of the pool, the coroutine
+     * is pushed into local deque of the worker. Otherwise it is injected into shared queue
+     */
+    void enqueue(prepared_coro coro) {
+        std::coroutine_handle<> h = coro.release();
+        if (!h) return;
+        worker *w = cur_worker;
+        if (w && w->owner == this) {
+            w->deque.push(h);
+        } else {
+            std::lock_guard _(_inject_mx);
+            _inject.push_back(h);
+            _inject_size.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake_one();
+    }
+
+    ///executor interface
+    void operator()(prepared_coro coro) {
+        enqueue(std::move(coro));
+    }
+
+    ///batch executor interface (see scheduler::run_thread)
+    /**
+     * Moves all coroutines to the pool with single lock of the injection queue
+     */
+    void operator()(std::span<prepared_coro> batch) {
+        worker *w = cur_worker;
+        std::size_t cnt = 0;
+        if (w && w->owner == this) {
+            for (auto &c: batch) if (c) {w->deque.push(c.release()); ++cnt;}
+        } else {
+            std::lock_guard _(_inject_mx);
+            for (auto &c: batch) if (c) {_inject.push_back(c.release()); ++cnt;}
+            _inject_size.fetch_add(cnt, std::memory_order_relaxed);
+        }
+        if (cnt) wake(cnt);
+    }
+
+    ///retrieve copyable executor
+    /**
+     * Use this executor for APIs which store the executor (scheduler::create_thread, result_proxy).
+     * The pool must outlive the executor
+     */
+    executor_type get_executor() {
+        return executor_type(*this);
+    }
+
+    ///Launch asynchronous operation in the pool
+    /**
+      @param awt awaiter / coroutine object which is would be otherwise co_awaited
+      @return pending object contains pending operation, which must be finally co_waited to join/synchronize
+     */
+    template<is_awaiter Awt>
+    pending<Awt> launch(Awt awt) {
+        return pending<Awt>(std::move(awt), get_executor());
+    }
+
+    ///test whether current thread is a worker of this pool
+    bool is_current() const {
+        worker *w = cur_worker;
+        return w && w->owner == this;
+    }
+
+    ///retrieve count of worker threads
+    std::size_t get_thread_count() const {
+        return _workers.size();
+    }
+
+    ///retrieve pool which owns current thread
+    /**
+     * @return pointer to the pool, or nullptr if current thread is not a worker of any pool
+     */
+    static thread_pool *current() {
+        worker *w = cur_worker;
+        return w?w->owner:nullptr;
+    }
+
+protected:
+
+    struct worker {
+        thread_pool *owner;
+        work_stealing_deque deque;
+        std::thread thr;
+        explicit worker(thread_pool *owner):owner(owner) {}
+    };
+
+    std::vector<std::unique_ptr<worker> > _workers;
+    std::mutex _inject_mx;
+    std::deque<std::coroutine_handle<> > _inject;
+    std::atomic<std::size_t> _inject_size = {0};
+    std::atomic<bool> _stop = {false};
+    //count of parked (or parking) workers
+    std::atomic<unsigned int> _sleeping = {0};
+    //parked workers wait for change of this value
+    std::atomic<unsigned int> _signal = {0};
+
+    static thread_local worker *cur_worker;
+
+    void wake_one() {
+        wake(1);
+    }
+
+    void wake(std::size_t cnt) {
+        //pairs with fence in park() - either the worker sees the task, or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed)) {
+            _signal.fetch_add(1, std::memory_order_release);
+            if (cnt > 1) _signal.notify_all(); else _signal.notify_one();
+        }
+    }
+
+    std::coroutine_handle<> pop_injected() {
+        if (!_inject_size.load(std::memory_order_relaxed)) return {};
+        std::lock_guard _(_inject_mx);
+        if (_inject.empty()) return {};
+        auto h = _inject.front();
+        _inject.pop_front();
+        _inject_size.fetch_sub(1, std::memory_order_relaxed);
+        return h;
+    }
+
+    bool has_work() const {
+        if (_inject_size.load(std::memory_order_relaxed)) return true;
+        for (const auto &w: _workers) if (!w->deque.empty()) return true;
+        return false;
+    }
+
+    std::coroutine_handle<> find_task(worker &w, std::minstd_rand &rnd) {
+        std::coroutine_handle<> h = w.deque.pop();
+        if (h) return h;
+        h = pop_injected();
+        if (h) return h;
+        std::size_t cnt = _workers.size();
+        std::size_t start = rnd() % cnt;
+        for (std::size_t i = 0; i < cnt; ++i) {
+            worker &v = *_workers[(start + i) % cnt];
+            if (&v == &w) continue;
+            h = v.deque.steal();
+            if (h) return h;
+        }
+        return {};
+    }
+
+    void park() {
+        _sleeping.fetch_add(1, std::memory_order_seq_cst);
+        unsigned int e = _signal.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_work() && !_stop.load(std::memory_order_relaxed)) {
+            _signal.wait(e, std::memory_order_acquire);
+        }
+        _sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void worker_main(worker &w) {
+        cur_worker = &w;
+        std::minstd_rand rnd(static_cast<unsigned int>(reinterpret_cast<std::uintptr_t>(&w)));
+        unsigned int idle = 0;
+        while (!_stop.load(std::memory_order_acquire)) {
+            std::coroutine_handle<> h = find_task(w, rnd);
+            if (h) {
+                idle = 0;
+                prepared_coro(h).lazy_resume();
+            } else if (++idle < spin_count) {
+                std::this_thread::yield();
+            } else {
+                idle = 0;
+                park();
+            }
+        }
+        cur_worker = nullptr;
+    }
+};
+
+inline thread_local thread_pool::worker *thread_pool::cur_worker = nullptr;
+
+///move current coroutine to a worker thread of the pool
+/**
+ * @param pool target pool
+ * @return awaiter. If the coroutine is already running in the pool, it continues without suspension
+ *
+ * @code
+ * co_await coro::resume_on(pool);
+ * @endcode
+ */
+inline thread_pool::resume_awaiter resume_on(thread_pool &pool) {
+    return thread_pool::resume_awaiter(pool);
+}
+
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace coro {
+
+///hierarchical timing wheel - timer queue with O(1) insert and cancel
+/**
+ * Drop-in replacement of generic_scheduler. It can be selected as timer queue of the
+ * scheduler or manual_scheduler
+ *
+ * @code
+ * coro::basic_scheduler<coro::timing_wheel> sch(std::chrono::milliseconds(1));
+ * @endcode
+ *
+ * Time is divided into ticks of configured resolution. Each level of the wheel has slot_count
+ * slots, a slot of the level N covers slot_count^N ticks. A timer is stored at the
+ * lowest level where it fits relatively to current position of the wheel. When the
+ * wheel advances to a slot of higher level, the timers of the slot are redistributed
+ * to lower levels (cascade). Each timer is cascaded at most level_count times.
+ *
+ * The wheel is cascaded eagerly, so the earliest timer is always at the level 0 and
+ * get_first_scheduled_time() is O(level_count). Because of this, the position of the
+ * wheel can be ahead of the current time. Timers scheduled before the position
+ * of the wheel are kept in a small binary heap, which is served first.
+ *
+ * Timers are rounded up to whole ticks - so they never expire early, but they can
+ * expire up to one tick late. Timers of the same tick expire in order of insertion.
+ *
+ * Items are kept in the pool of nodes linked by indices, the identity is indexed by a hash
+ * table, so remove_by_ident() doesn't need to search.
+ *
+ * @tparam T type of stored item (must be default constructible)
+ * @tparam _TP time point (std::chrono::time_point)
+ * @tparam _Ident identity of the item, used for cancellation. Default constructed identity
+ * is not indexed
+ */
+template<typename T, typename _TP, typename _Ident = const void *>
+class timing_wheel {
+public:
+
+    using duration = typename _TP::duration;
+
+    ///bits per level
+    static constexpr unsigned int slot_bits = 6;
+    ///count of slots per level
+    static constexpr unsigned int slot_count = 1U << slot_bits;
+    ///count of levels, which covers whole 64bit range of ticks
+    static constexpr unsigned int level_count = (64 + slot_bits - 1) / slot_bits;
+
+    ///construct the wheel
+    /**
+     * @param resolution length of one tick
+     */
+    explicit timing_wheel(duration resolution = default_resolution())
+        :_resolution(std::max(resolution, duration(1))) {}
+
+    void schedule_at(T x, _TP timestamp, _Ident ident) {
+        std::uint32_t idx = alloc_node();
+        node &n = _nodes[idx];
+        n.res = std::move(x);
+        n.ident = ident;
+        n.tick = to_tick(timestamp);
+        //empty wheel is positioned at the first timer
+        if (!_count) _cursor = n.tick;
+        link(idx);
+        if (ident != _Ident{}) _index.emplace(ident, idx);
+        ++_count;
+    }
+
+    std::optional<_TP> get_first_scheduled_time() const {
+        if (!_count) return {};
+        if (!_early.empty()) return from_tick(_nodes[_early.front()].tick);
+        //all timers of a slot of the level 0 share the same tick
+        unsigned int s = static_cast<unsigned int>(std::countr_zero(_mask[0]));
+        return from_tick(_nodes[_slots[0][s].head].tick);
+    }
+
+    T remove_first() {
+        if (!_count) return T{};
+        std::uint32_t idx;
+        if (!_early.empty()) {
+            idx = _early.front();
+        } else {
+            unsigned int s = static_cast<unsigned int>(std::countr_zero(_mask[0]));
+            idx = _slots[0][s].head;
+            _cursor = _nodes[idx].tick;
+        }
+        T r = remove_node(idx);
+        normalize();
+        return r;
+    }
+
+    T remove_by_ident(_Ident ident) {
+        auto iter = _index.find(ident);
+        if (iter == _index.end()) return T{};
+        T r = remove_node(iter->second);
+        normalize();
+        return r;
+    }
+
+    ///set task time, update its position in the wheel
+    bool set_time(_Ident ident, _TP new_tp) {
+        auto rng = _index.equal_range(ident);
+        if (rng.first == rng.second) return false;
+        for (auto iter = rng.first; iter != rng.second; ++iter) {
+            std::uint32_t idx = iter->second;
+            unlink(idx);
+            _nodes[idx].tick = to_tick(new_tp);
+            link(idx);
+        }
+        normalize();
+        return true;
+    }
+
+    bool empty() const {
+        return _count == 0;
+    }
+
+    ///retrieve count of scheduled items
+    std::size_t size() const {
+        return _count;
+    }
+
+    ///retrieve length of one tick
+    duration get_resolution() const {
+        return _resolution;
+    }
+
+protected:
+
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
+    //level of the nodes stored in the heap of early timers
+    static constexpr std::uint8_t early_level = 0xFF;
+
+    struct node {
+        T res = {};
+        _Ident ident = {};
+        std::uint64_t tick = 0;
+        std::uint32_t prev = npos;
+        std::uint32_t next = npos;
+        //position in the heap of early timers
+        std::uint32_t heap_pos = npos;
+        //order of insertion, keeps early timers of the same tick in order
+        std::uint64_t seq = 0;
+        std::uint8_t level = 0;
+        std::uint8_t slot_idx = 0;
+    };
+
+    struct slot {
+        std::uint32_t head = npos;
+        std::uint32_t tail = npos;
+    };
+
+    duration _resolution;
+    //all ticks lower than cursor already expired
+    std::uint64_t _cursor = 0;
+    std::size_t _count = 0;
+    std::vector<node> _nodes;
+    std::uint32_t _free = npos;
+    std::array<std::array<slot, slot_count>, level_count> _slots = {};
+    std::array<std::uint64_t, level_count> _mask = {};
+    std::unordered_multimap<_Ident, std::uint32_t> _index;
+    //binary heap of timers scheduled before the cursor
+    std::vector<std::uint32_t> _early;
+    std::uint64_t _seq = 0;
+
+    static duration default_resolution() {
+        return std::max(std::chrono::duration_cast<duration>(std::chrono::milliseconds(1)), duration(1));
+    }
+
+    std::uint64_t to_tick(_TP tp) const {
+        duration d = tp - _TP{};
+        if (d <= duration::zero()) return 0;
+        auto t = static_cast<std::uint64_t>(d / _resolution);
+        if (d % _resolution != duration::zero()) ++t;
+        return t;
+    }
+
+    _TP from_tick(std::uint64_t t) const {
+        return _TP{} + _resolution * static_cast<typename duration::rep>(t);
+    }
+
+    unsigned int first_level() const {
+        unsigned int l = 0;
+        while (!_mask[l]) ++l;
+        return l;
+    }
+
+    std::size_t wheel_count() const {
+        return _count - _early.size();
+    }
+
+    std::uint64_t min_tick_of_slot(const slot &sl) const {
+        std::uint64_t r = ~std::uint64_t(0);
+        for (std::uint32_t i = sl.head; i != npos; i = _nodes[i].next) r = std::min(r, _nodes[i].tick);
+        return r;
+    }
+
+    std::uint32_t alloc_node() {
+        if (_free != npos) {
+            std::uint32_t idx = _free;
+            _free = _nodes[idx].next;
+            return idx;
+        }
+        _nodes.emplace_back();
+        return static_cast<std::uint32_t>(_nodes.size() - 1);
+    }
+
+    //places node to a slot relative to the cursor
+    void link(std::uint32_t idx) {
+        node &n = _nodes[idx];
+        if (n.tick < _cursor) {
+            early_push(idx);
+            return;
+        }
+        std::uint64_t diff = n.tick ^ _cursor;
+        unsigned int l = diff?static_cast<unsigned int>(63 - std::countl_zero(diff)) / slot_bits:0;
+        unsigned int s = static_cast<unsigned int>(n.tick >> (l * slot_bits)) & (slot_count - 1);
+        n.level = static_cast<std::uint8_t>(l);
+        n.slot_idx = static_cast<std::uint8_t>(s);
+        slot &sl = _slots[l][s];
+        n.prev = sl.tail;
+        n.next = npos;
+        if (sl.tail != npos) _nodes[sl.tail].next = idx; else sl.head = idx;
+        sl.tail = idx;
+        _mask[l] |= std::uint64_t(1) << s;
+    }
+
+    void unlink(std::uint32_t idx) {
+        node &n = _nodes[idx];
+        if (n.level == early_level) {
+            early_erase(idx);
+            return;
+        }
+        slot &sl = _slots[n.level][n.slot_idx];
+        if (n.prev != npos) _nodes[n.prev].next = n.next; else sl.head = n.next;
+        if (n.next != npos) _nodes[n.next].prev = n.prev; else sl.tail = n.prev;
+        if (sl.head == npos) _mask[n.level] &= ~(std::uint64_t(1) << n.slot_idx);
+    }
+
+    T remove_node(std::uint32_t idx) {
+        unlink(idx);
+        node &n = _nodes[idx];
+        if (n.ident != _Ident{}) {
+            auto rng = _index.equal_range(n.ident);
+            for (auto iter = rng.first; iter != rng.second; ++iter) {
+                if (iter->second == idx) {
+                    _index.erase(iter);
+                    break;
+                }
+            }
+        }
+        T r = std::move(n.res);
+        n.res = T{};
+        n.ident = _Ident{};
+        n.next = _free;
+        _free = idx;
+        --_count;
+        return r;
+    }
+
+    //advances cursor to the earliest timer of the slot and redistributes timers of the slot
+    void cascade(slot &sl) {
+        _cursor = min_tick_of_slot(sl);
+        std::uint32_t i = sl.head;
+        unsigned int l = _nodes[i].level;
+        _mask[l] &= ~(std::uint64_t(1) << _nodes[i].slot_idx);
+        sl = {};
+        while (i != npos) {
+            std::uint32_t nx = _nodes[i].next;
+            link(i);
+            i = nx;
+        }
+    }
+
+    //keeps the earliest timer of the wheel at the level 0
+    void normalize() {
+        if (wheel_count() && !_mask[0]) {
+            unsigned int l = first_level();
+            cascade(_slots[l][std::countr_zero(_mask[l])]);
+        }
+    }
+
+    bool early_less(std::uint32_t a, std::uint32_t b) const {
+        const node &na = _nodes[a];
+        const node &nb = _nodes[b];
+        return na.tick < nb.tick || (na.tick == nb.tick && na.seq < nb.seq);
+    }
+
+    void early_place(std::uint32_t idx, std::size_t pos) {
+        _early[pos] = idx;
+        _nodes[idx].heap_pos = static_cast<std::uint32_t>(pos);
+    }
+
+    void early_up(std::size_t pos) {
+        std::uint32_t idx = _early[pos];
+        while (pos) {
+            std::size_t parent = (pos - 1) / 2;
+            if (!early_less(idx, _early[parent])) break;
+            early_place(_early[parent], pos);
+            pos = parent;
+        }
+        early_place(idx, pos);
+    }
+
+    void early_down(std::size_t pos) {
+        std::uint32_t idx = _early[pos];
+        std::size_t sz = _early.size();
+        while (true) {
+            std::size_t c = pos * 2 + 1;
+            if (c >= sz) break;
+            if (c + 1 < sz && early_less(_early[c + 1], _early[c])) ++c;
+            if (!early_less(_early[c], idx)) break;
+            early_place(_early[c], pos);
+            pos = c;
+        }
+        early_place(idx, pos);
+    }
+
+    void early_push(std::uint32_t idx) {
+        node &n = _nodes[idx];
+        n.level = early_level;
+        n.seq = _seq++;
+        _early.push_back(idx);
+        early_up(_early.size() - 1);
+    }
+
+    void early_erase(std::uint32_t idx) {
+        std::size_t pos = _nodes[idx].heap_pos;
+        _nodes[idx].heap_pos = npos;
+        std::uint32_t last = _early.back();
+        _early.pop_back();
+        if (last == idx) return;
+        _early[pos] = last;
+        early_up(pos);
+        early_down(_nodes[last].heap_pos);
+    }
+};
+
+}
@@ -2,6 +2,7 @@
 #include "concepts.hpp"
 #include <coroutine>
 #include <source_location>
+#include <string_view>
 
 
 #ifdef BASIC_CORO_ENABLE_TRACE
@@ -12,6 +13,7 @@
     void basic_coro_trace_suspend(std::coroutine_handle<> h, std::source_location loc) noexcept;
     void basic_coro_trace_resume(std::coroutine_handle<> h) noexcept;
     void basic_coro_trace_exception(std::coroutine_handle<> h) noexcept;
+    void basic_coro_trace_callback_spill(std::string_view callback_type, std::size_t callback_size, std::size_t reserved_space) noexcept;
 #else
     inline void basic_coro_trace_create(std::coroutine_handle<>) noexcept {}
     inline void basic_coro_trace_destroy(std::coroutine_handle<>) noexcept {}
@@ -20,6 +22,7 @@
     inline void basic_coro_trace_setname(std::coroutine_handle<>, std::string_view) noexcept {}
     inline void basic_coro_trace_resume(std::coroutine_handle<> ) noexcept {}
     inline void basic_coro_trace_exception(std::coroutine_handle<> ) noexcept {}
+    inline void basic_coro_trace_callback_spill(std::string_view, std::size_t, std::size_t) noexcept {}
 #endif
 
 namespace coro {
@@ -8,10 +8,14 @@
 template class coro::async_generator<int>;
 template class coro::queue<int, 128>;
 template class coro::queue<int>;
+template class coro::queue<int, 0, coro::empty_lockable, coro::queue_stats<> >;
 template class coro::multi_lock<10>;
 template class coro::awaitable<const int &>;
 template class coro::awaitable<int &>;
 template class coro::distributor<const int>;
+template class coro::distributor<std::shared_ptr<const int> >;
+template class coro::sharded_distributor<int>;
+template class coro::multicast_ring<int>;
 template class coro::pmr_allocator<>;
 
 
@@ -0,0 +1,85 @@
+#include "check.h"
+#include <basic_coro/arena_allocator.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/awaitable.hpp>
+#include <thread>
+
+coro::coroutine<int, coro::arena_allocator> recursive_fibo(int val) {
+    if (val <= 1) {
+        co_return val;
+    }
+    int a = co_await recursive_fibo(val - 1);
+    int b = co_await recursive_fibo(val - 2);
+    co_return a+b;
+}
+
+//resumes awaiting coroutine in other thread
+coro::awaitable<void> switch_thread() {
+    return [](coro::awaitable<void>::result r) {
+        std::thread thr([r = std::move(r)]() mutable {r();});
+        thr.detach();
+    };
+}
+
+coro::coroutine<coro::request_arena *, coro::arena_allocator> child() {
+    co_return coro::request_arena::current();
+}
+
+coro::coroutine<bool, coro::arena_allocator> request(coro::request_arena *expected) {
+    co_await switch_thread();
+    //other thread, child is still allocated in the arena
+    auto before = expected->get_ref_count();
+    auto c = child();
+    auto after = expected->get_ref_count();
+    auto r = co_await c;
+    co_return r == expected && after == before + 1;
+}
+
+coro::awaitable<void>::result parked;
+
+//plain coroutine (not allocated in arena), which suspends
+coro::coroutine<void> plain_wait() {
+    co_await coro::awaitable<void>([](coro::awaitable<void>::result r){parked = std::move(r);});
+}
+
+coro::coroutine<void, coro::arena_allocator> transfer_to_plain() {
+    co_await plain_wait();
+}
+
+void transfer_test(coro::arena_pool &pool) {
+    auto arena = pool.acquire();
+    coro::request_arena *ptr = arena.get();
+    //started in detached mode, runs until plain_wait() suspends
+    coro::run_in_arena(arena, []{return transfer_to_plain();});
+    //the arena must not stay associated with the thread
+    CHECK_EQUAL(coro::request_arena::current(), nullptr);
+    auto refs = ptr->get_ref_count();
+    auto c = child();
+    CHECK_EQUAL(ptr->get_ref_count(), refs);
+    coro::request_arena *r = c.get();
+    CHECK_EQUAL(r, nullptr);
+    parked();
+}
+
+int main() {
+    coro::arena_pool pool;
+    int val = coro::run_in_arena(pool.acquire(), []{return recursive_fibo(15);});
+    CHECK_EQUAL(val, 610);
+    CHECK_EQUAL(pool.get_idle_count(), 1);
+
+    auto arena = pool.acquire();
+    CHECK_EQUAL(pool.get_idle_count(), 0);
+    CHECK_EQUAL(arena->get_reserved(), coro::request_arena::default_chunk_size);
+    coro::request_arena *ptr = arena.get();
+    bool ok = coro::run_in_arena(std::move(arena), [&]{return request(ptr);});
+    CHECK(ok);
+    CHECK_EQUAL(pool.get_idle_count(), 1);
+
+    //without arena, frames are allocated on heap
+    CHECK_EQUAL(coro::request_arena::current(), nullptr);
+    val = recursive_fibo(10);
+    CHECK_EQUAL(val, 55);
+
+    transfer_test(pool);
+    CHECK_EQUAL(pool.get_idle_count(), 1);
+}
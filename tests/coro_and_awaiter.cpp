@@ -1,6 +1,9 @@
 #include <iostream>
 #include <sstream>
 #include <thread>
+#include <array>
+#include <cstdint>
+#include <vector>
 #include "check.h"
 
 #include <basic_coro/awaitable.hpp>
@@ -111,6 +114,48 @@ void detached_test() {
 }
 
 
+void callback_spill_test() {
+    std::array<int, 32> data;
+    for (int i = 0; i < 32; ++i) data[i] = i;
+    //callback doesn't fit into reserved space
+    awaitable<int> a([data](awaitable<int>::result r) {
+        r(data[5]);
+    });
+    CHECK_EQUAL(a.get(), 5);
+    awaitable<int> b([data](awaitable<int>::result r) {
+        return r(data[7]);
+    });
+    awaitable<int> c = std::move(b);
+    CHECK_EQUAL(c.get(), 7);
+    //over-aligned callback
+    struct alignas(64) aligned_data {
+        int v[20];
+    };
+    aligned_data adata = {};
+    adata.v[3] = 3;
+    awaitable<int> d([adata](awaitable<int>::result r) {
+        bool aligned = reinterpret_cast<std::uintptr_t>(&adata) % 64 == 0;
+        r(aligned?adata.v[3]:-1);
+    });
+    awaitable<int> e = std::move(d);
+    CHECK_EQUAL(e.get(), 3);
+}
+
+//destroyed at exit, after the thread cache of the main thread
+std::vector<awaitable<int> > pending_at_exit;
+
+void callback_spill_at_exit_test() {
+    std::array<int, 32> data = {};
+    //callbacks are never called, they are released during destruction of static objects
+    for (int i = 0; i < 260; ++i) {
+        pending_at_exit.emplace_back([data](awaitable<int>::result r) {
+            r(data[0]);
+        });
+    }
+    //the thread cache holds released blocks at exit
+    pending_at_exit.resize(200);
+    CHECK_EQUAL(pending_at_exit.size(), 200U);
+}
 
 int main() {
     std::ostringstream s;
@@ -121,5 +166,7 @@ int main() {
     CHECK_EQUAL(s.view(),"different");
     reusable_test();
     detached_test();
+    callback_spill_test();
+    callback_spill_at_exit_test();
     return 0;
 }
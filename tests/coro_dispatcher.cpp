@@ -5,6 +5,7 @@
 #include <basic_coro/coroutine.hpp>
 #include <basic_coro/trace.hpp>
 #include <thread>
+#include <vector>
 
 coro::awaitable<int> api_call_run() {
     return [](auto promise) {
@@ -28,7 +29,41 @@ coro::awaitable<int> run_fn() {
     co_return r;
 }
 
+//each producer enqueues tasks, which must be executed in order of the producer
+void multi_producer_test() {
+    constexpr int producers = 8;
+    constexpr int tasks = 1000;
+    auto disp = coro::dispatch_thread::create();
+    std::vector<int> last(producers, -1);
+    std::atomic<int> executed = {0};
+    bool ordered = true;
+    {
+        std::vector<std::jthread> thrs;
+        for (int i = 0; i < producers; ++i) {
+            thrs.emplace_back([&, i]{
+                for (int j = 0; j < tasks; ++j) {
+                    disp->enqueue([](int id, int seq, std::vector<int> &last, bool &ordered, std::atomic<int> &executed) -> coro::prepared_coro {
+                        if (last[id] + 1 != seq) ordered = false;
+                        last[id] = seq;
+                        executed.fetch_add(1);
+                        executed.notify_all();
+                        co_return;
+                    }(i, j, last, ordered, executed));
+                }
+            });
+        }
+    }
+    int v = executed.load();
+    while (v != producers * tasks) {
+        executed.wait(v);
+        v = executed.load();
+    }
+    CHECK(ordered);
+    coro::sync_await(coro::dispatch_thread::join(std::move(disp)));
+}
+
 int main() {
+    multi_producer_test();
     auto disp = coro::dispatch_thread::create();
     //launch in dispatcher
     auto fnres = disp->launch(run_fn());
@@ -1,8 +1,18 @@
 #include <basic_coro/distributor.hpp>
 #include <basic_coro/when_each.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/thread_pool.hpp>
 #include "basic_coro/cancel_signal.hpp"
 #include "check.h"
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 
 using namespace coro;
 
@@ -36,8 +46,266 @@ awaitable<void> coro_alert_test(distributor<int, empty_lockable> &dist, cancel_s
     }
 }
 
+struct message {
+    static inline int copies = 0;
+    static inline int alive = 0;
+    int val;
+    message(int v):val(v) {++alive;}
+    message(const message &other):val(other.val) {++copies;++alive;}
+    ~message() {--alive;}
+};
+
+using shared_dist = distributor<std::shared_ptr<const message>, std::mutex>;
+
+coroutine<void> shared_listener(shared_dist &dist, const message *&addr, int &val) {
+    std::shared_ptr<const message> m = co_await dist();
+    addr = m.get();
+    val = m->val;
+}
+
+void shared_broadcast_test() {
+    shared_dist dist;
+    const message *a1 = nullptr;
+    const message *a2 = nullptr;
+    int v1 = 0;
+    int v2 = 0;
+    shared_listener(dist, a1, v1);
+    shared_listener(dist, a2, v2);
+    std::vector<prepared_coro> buff;
+    dist.broadcast_shared(buff, 42);
+    CHECK_EQUAL(buff.size(), 2U);
+    CHECK_EQUAL(message::alive, 1);
+    buff.clear();
+    CHECK_EQUAL(v1, 42);
+    CHECK_EQUAL(v2, 42);
+    //single instance, released after the last listener
+    CHECK(a1 == a2);
+    CHECK_EQUAL(message::copies, 0);
+    CHECK_EQUAL(message::alive, 0);
+    CHECK(dist.empty());
+
+    //listener which is not a coroutine keeps the value after it was woken up
+    int v3 = 0;
+    std::thread thr([&]{
+        auto m = dist().get();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        v3 = m->val;
+    });
+    while (dist.empty()) std::this_thread::yield();
+    dist.broadcast_shared(56);
+    thr.join();
+    CHECK_EQUAL(v3, 56);
+    CHECK_EQUAL(message::copies, 0);
+    CHECK_EQUAL(message::alive, 0);
+}
+
+coroutine<void> subscriber(distributor<int> &dist, std::vector<int> &out) {
+    distributor<int>::subscription sub(dist);
+    while (true) {
+        int v = co_await sub.next();
+        out.push_back(v);
+        if (v < 0) break;
+    }
+}
+
+void subscription_test() {
+    distributor<int> dist;
+    std::vector<int> out;
+    subscriber(dist, out);
+    distributor<int>::subscription sub(dist, 2);
+    dist.broadcast(1);
+    CHECK_EQUAL(out.size(), 1U);
+    //values arriving while the subscriber is not awaiting are kept in the inbox
+    for (int i = 2; i <= 5; ++i) dist.broadcast(i);
+    CHECK_EQUAL(sub.pending(), 5U);
+    for (int i = 1; i <= 5; ++i) {
+        auto r = sub.next();
+        CHECK(r.is_ready());
+        int v = r.await_resume();
+        CHECK_EQUAL(v, i);
+    }
+    int received = 0;
+    sub.next() >> [&](auto &r) {received = r.await_resume();};
+    CHECK_EQUAL(received, 0);
+    dist.broadcast(-1);
+    CHECK_EQUAL(received, -1);
+    std::vector<int> expect = {1,2,3,4,5,-1};
+    CHECK(out == expect);
+    CHECK(!dist.empty());
+}
+
+coroutine<void> counting_listener(distributor<int> &dist, cancel_signal *sig, int &received, int &canceled) {
+    try {
+        received += co_await dist(sig);
+    } catch (const await_canceled_exception &) {
+        ++canceled;
+    }
+}
+
+void cancel_test() {
+    distributor<int> dist;
+    cancel_signal sigs[6];
+    int received = 0;
+    int canceled = 0;
+    for (auto &s: sigs) counting_listener(dist, &s, received, canceled);
+    //first, middle, last - moves other listeners
+    dist.cancel(&sigs[0]);
+    dist.cancel(&sigs[3]);
+    dist.cancel(&sigs[5]);
+    //not registered (already canceled)
+    dist.cancel(&sigs[3]);
+    CHECK_EQUAL(canceled, 3);
+    dist.broadcast(1);
+    CHECK_EQUAL(received, 3);
+    //not registered (already received)
+    dist.cancel(&sigs[1]);
+    CHECK_EQUAL(canceled, 3);
+    CHECK(dist.empty());
+}
+
+coroutine<void> sharded_listener(sharded_distributor<int, std::mutex, thread_pool::executor_type> &dist,
+                                 std::atomic<int> &received, std::atomic<int> &in_pool, thread_pool &pool) {
+    int v = co_await dist();
+    if (pool.is_current()) in_pool.fetch_add(1);
+    received.fetch_add(v);
+    received.notify_all();
+}
+
+coroutine<void> counting_listener_sharded(sharded_distributor<int> &dist, cancel_signal *sig, int &received, int &canceled) {
+    try {
+        received += co_await dist(sig);
+    } catch (const await_canceled_exception &) {
+        ++canceled;
+    }
+}
+
+void sharded_test() {
+    {
+        sharded_distributor<int> dist(4);
+        CHECK_EQUAL(dist.shard_count(), 4U);
+        cancel_signal sigs[8];
+        int received = 0;
+        int canceled = 0;
+        for (auto &s: sigs) counting_listener_sharded(dist, &s, received, canceled);
+        dist.cancel(&sigs[2]);
+        dist.cancel(&sigs[7]);
+        dist.broadcast(1);
+        CHECK_EQUAL(received, 6);
+        CHECK_EQUAL(canceled, 2);
+        CHECK(dist.empty());
+    }
+    {
+        thread_pool pool(2);
+        sharded_distributor<int, std::mutex, thread_pool::executor_type> dist(
+                {pool.get_executor(), pool.get_executor(), pool.get_executor()});
+        std::atomic<int> received = {0};
+        std::atomic<int> in_pool = {0};
+        for (int i = 0; i < 9; ++i) sharded_listener(dist, received, in_pool, pool);
+        dist.broadcast(1);
+        int r = received.load();
+        while (r != 9) {
+            received.wait(r);
+            r = received.load();
+        }
+        CHECK_EQUAL(in_pool.load(), 9);
+    }
+}
+
+coroutine<void> parallel_listener(distributor<int, std::mutex> &dist, std::atomic<int> &received, thread_pool &pool, std::atomic<int> &in_pool) {
+    int v = co_await dist();
+    if (pool.is_current()) in_pool.fetch_add(1);
+    received.fetch_add(v);
+}
+
+void broadcast_on_test() {
+    thread_pool pool(2);
+    distributor<int, std::mutex> dist;
+    std::atomic<int> received = {0};
+    std::atomic<int> in_pool = {0};
+    for (int i = 0; i < 20; ++i) parallel_listener(dist, received, pool, in_pool);
+    //join awaitable completes after all listeners ran
+    dist.broadcast_on(pool, 3, 2).wait();
+    CHECK_EQUAL(received.load(), 40);
+    CHECK_EQUAL(in_pool.load(), 20);
+    CHECK(dist.empty());
+    //no listeners - resolved immediately
+    auto j = dist.broadcast_on(pool, 3, 2);
+    CHECK(j.is_ready());
+    //set of executors, join is not awaited
+    for (int i = 0; i < 5; ++i) parallel_listener(dist, received, pool, in_pool);
+    int tasks = 0;
+    auto exec = [&](prepared_coro c) {++tasks; c.resume();};
+    std::vector<decltype(exec)> execs = {exec, exec};
+    dist.broadcast_on(std::span(execs), 2, 1);
+    CHECK_EQUAL(tasks, 3);
+    CHECK_EQUAL(received.load(), 45);
+    //no executor - rejected, listeners stay registered
+    parallel_listener(dist, received, pool, in_pool);
+    bool thrown = false;
+    try {
+        dist.broadcast_on(std::span<decltype(exec)>(), 2, 1);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!dist.empty());
+    dist.broadcast_on(std::span(execs), 2, 1);
+    CHECK_EQUAL(received.load(), 46);
+    //shared value is released after all listeners ran
+    shared_dist sdist;
+    const message *a1 = nullptr;
+    const message *a2 = nullptr;
+    int v1 = 0;
+    int v2 = 0;
+    shared_listener(sdist, a1, v1);
+    shared_listener(sdist, a2, v2);
+    sdist.broadcast_on(pool, 1, 7).wait();
+    CHECK_EQUAL(v1 + v2, 14);
+    CHECK_EQUAL(message::alive, 0);
+    CHECK_EQUAL(message::copies, 0);
+}
+
+template<typename Dist>
+coroutine<void> sum_listener(Dist &dist, int &received) {
+    received += co_await dist();
+}
+
+void generic_executor_test() {
+    //generic lambda is called per coroutine, never with the span
+    std::deque<prepared_coro> queue;
+    auto exec = [&](auto &&c) {queue.push_back(std::move(c));};
+    distributor<int> dist;
+    int received = 0;
+    for (int i = 0; i < 4; ++i) sum_listener(dist, received);
+    dist.broadcast_on(exec, 2, 1);
+    CHECK_EQUAL(queue.size(), 2U);
+    std::vector<decltype(exec)> execs = {exec, exec};
+    //no listeners left, just compiles
+    dist.broadcast_on(std::span(execs), 2, 1);
+    //one coroutine per listener
+    sharded_distributor<int, empty_lockable, decltype(exec)> sdist(execs);
+    int sreceived = 0;
+    for (int i = 0; i < 4; ++i) sum_listener(sdist, sreceived);
+    sdist.broadcast(3);
+    CHECK_EQUAL(received, 0);
+    CHECK_EQUAL(sreceived, 0);
+    CHECK_EQUAL(queue.size(), 6U);
+    while (!queue.empty()) {
+        auto c = std::move(queue.front());
+        queue.pop_front();
+        c.resume();
+    }
+    CHECK_EQUAL(received, 4);
+    CHECK_EQUAL(sreceived, 12);
+}
 
 int main() {
+    broadcast_on_test();
+    generic_executor_test();
+    shared_broadcast_test();
+    subscription_test();
+    cancel_test();
+    sharded_test();
     cancel_signal ident_a;
     cancel_signal ident_b;
     cancel_signal ident_c;
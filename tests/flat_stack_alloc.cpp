@@ -26,10 +26,72 @@ coro::coroutine<int, coro::pmr_allocator<coro::flat_stack_memory_resource *> > r
     co_return (co_await awt1) + (co_await awt2);
 }
 
+coro::coroutine<int, coro::pmr_allocator<coro::segmented_stack_memory_resource *> > recursive_fibo_3(coro::pmr_allocator<coro::segmented_stack_memory_resource *> alloc, int val) {
+    if (val <= 1) {
+        co_return val;
+    }
+    co_await coro::co_switch();
+    auto awt1 = recursive_fibo_3(alloc, val - 1);
+    auto awt2 = recursive_fibo_3(alloc, val - 2);
+    co_return (co_await awt1) + (co_await awt2);
+}
+
+class counting_resource: public std::pmr::memory_resource {
+public:
+    int allocs = 0;
+    int deallocs = 0;
+protected:
+    virtual void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocs;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        ++deallocs;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    virtual bool do_is_equal(const memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void segmented_test() {
+    counting_resource cnt;
+    {
+        coro::segmented_stack_memory_resource mres(256, 1, &cnt);
+        void *a = mres.allocate(200);
+        CHECK_EQUAL(mres.get_segment_count(), 1);
+        //oscillate around segment boundary
+        for (int i = 0; i < 10; ++i) {
+            void *b = mres.allocate(200);
+            mres.deallocate(b, 200);
+        }
+        CHECK_EQUAL(mres.get_segment_count(), 2);
+        CHECK_EQUAL(cnt.allocs, 2);
+        //large block
+        void *c = mres.allocate(1000);
+        void *d = mres.allocate(1000);
+        CHECK_EQUAL(mres.get_segment_count(), 3);
+        mres.deallocate(c, 1000);
+        mres.deallocate(d, 1000);
+        //one spare segment is kept
+        CHECK_EQUAL(mres.get_segment_count(), 2);
+        mres.deallocate(a, 200);
+        void *e = mres.allocate(200);
+        CHECK_EQUAL(a, e);
+        mres.deallocate(e, 200);
+    }
+    CHECK_EQUAL(cnt.allocs, cnt.deallocs);
+}
+
 int main() {
     coro::flat_stack_memory_resource mres(30000);
     int val = recursive_fibo(&mres, 20);
     CHECK_EQUAL(val, 6765);
     val = recursive_fibo_2(&mres, 20);
     CHECK_EQUAL(val, 6765);
+    coro::segmented_stack_memory_resource smres(1024);
+    val = recursive_fibo_3(&smres, 20);
+    CHECK_EQUAL(val, 6765);
+    CHECK_LESS_EQUAL(smres.get_segment_count(), 2);
+    segmented_test();
 }
\ No newline at end of file
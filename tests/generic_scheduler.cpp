@@ -0,0 +1,156 @@
+#include <basic_coro/scheduler.hpp>
+
+#include "check.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace coro;
+
+//reference model - items ordered by time, items of the same time can be in any order
+class model {
+public:
+    struct entry {
+        int time;
+        const void *ident;
+    };
+
+    void schedule_at(int value, int time, const void *ident) {
+        _items.emplace(value, entry{time, ident});
+        _by_time.emplace(time, value);
+    }
+
+    bool has(int value) const {
+        return _items.find(value) != _items.end();
+    }
+
+    const entry &get(int value) const {
+        return _items.at(value);
+    }
+
+    void remove(int value) {
+        auto iter = _items.find(value);
+        erase_time(iter->second.time, value);
+        _items.erase(iter);
+    }
+
+    void set_time(int value, int time) {
+        auto &e = _items.at(value);
+        erase_time(e.time, value);
+        e.time = time;
+        _by_time.emplace(time, value);
+    }
+
+    std::vector<int> find_ident(const void *ident) const {
+        std::vector<int> r;
+        for (const auto &[v, e]: _items) if (e.ident == ident) r.push_back(v);
+        return r;
+    }
+
+    std::optional<int> first_time() const {
+        if (_by_time.empty()) return {};
+        return _by_time.begin()->first;
+    }
+
+    std::size_t size() const {
+        return _items.size();
+    }
+
+protected:
+    std::map<int, entry> _items;
+    std::multimap<int, int> _by_time;
+
+    void erase_time(int time, int value) {
+        auto rng = _by_time.equal_range(time);
+        for (auto iter = rng.first; iter != rng.second; ++iter) {
+            if (iter->second == value) {
+                _by_time.erase(iter);
+                return;
+            }
+        }
+    }
+};
+
+//compares the heap with the model by random operations
+void random_test(unsigned int seed, int time_range, std::size_t ident_count) {
+    generic_scheduler<int, int, const void *> heap;
+    model m;
+    //small count of idents, so the same ident is used by multiple items
+    std::vector<char> idents(ident_count);
+    std::mt19937 rnd(seed);
+    auto random_ident = [&]() -> const void * {
+        //every fifth item has no ident
+        auto n = rnd() % (ident_count + ident_count / 4);
+        return n < ident_count?&idents[n]:nullptr;
+    };
+    int next = 1;
+    bool order_ok = true;
+    bool remove_ok = true;
+    bool set_time_ok = true;
+    bool state_ok = true;
+    for (int op = 0; op < 50000; ++op) {
+        unsigned int k = rnd() % 10;
+        if (k < 4) {
+            int t = static_cast<int>(rnd() % static_cast<unsigned int>(time_range));
+            const void *id = random_ident();
+            heap.schedule_at(next, t, id);
+            m.schedule_at(next, t, id);
+            ++next;
+        } else if (k < 6) {
+            auto ft = m.first_time();
+            int r = heap.remove_first();
+            if (!ft) {
+                order_ok = order_ok && r == 0;
+            } else {
+                //removed item must exist and must have the lowest time
+                order_ok = order_ok && m.has(r) && m.get(r).time == *ft;
+                if (m.has(r)) m.remove(r);
+            }
+        } else if (k < 8) {
+            //interior removal
+            const void *id = &idents[rnd() % ident_count];
+            auto expected = m.find_ident(id);
+            int r = heap.remove_by_ident(id);
+            if (expected.empty()) {
+                remove_ok = remove_ok && r == 0;
+            } else {
+                remove_ok = remove_ok && m.has(r) && m.get(r).ident == id;
+                if (m.has(r)) m.remove(r);
+            }
+        } else {
+            //move up or down
+            const void *id = &idents[rnd() % ident_count];
+            int t = static_cast<int>(rnd() % static_cast<unsigned int>(time_range));
+            auto expected = m.find_ident(id);
+            bool r = heap.set_time(id, t);
+            set_time_ok = set_time_ok && r == !expected.empty();
+            for (int v: expected) m.set_time(v, t);
+        }
+        state_ok = state_ok && heap.size() == m.size() && heap.get_first_scheduled_time() == m.first_time();
+    }
+    CHECK(order_ok);
+    CHECK(remove_ok);
+    CHECK(set_time_ok);
+    CHECK(state_ok);
+    //drain - all items are returned in order of time
+    bool drain_ok = true;
+    while (!heap.empty()) {
+        auto ft = m.first_time();
+        int r = heap.remove_first();
+        drain_ok = drain_ok && ft && m.has(r) && m.get(r).time == *ft;
+        if (m.has(r)) m.remove(r);
+    }
+    CHECK(drain_ok);
+    CHECK_EQUAL(m.size(), 0U);
+}
+
+int main() {
+    //many duplicate times
+    random_test(1, 50, 16);
+    //mostly unique times, many duplicate idents
+    random_test(2, 1000000, 8);
+    //mostly unique idents
+    random_test(3, 1000000, 4000);
+    return 0;
+}
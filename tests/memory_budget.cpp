@@ -0,0 +1,83 @@
+#include "check.h"
+#include <basic_coro/memory_budget.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/awaitable.hpp>
+#include <basic_coro/thread_pool.hpp>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+coro::coroutine<int, coro::budget_allocator<> > work(coro::budget_allocator<>, coro::awaitable<int> &trigger) {
+    co_return co_await trigger;
+}
+
+coro::coroutine<void> admitted(coro::memory_budget &budget, std::vector<int> &order, int id) {
+    co_await budget.admit();
+    order.push_back(id);
+}
+
+void admit_test() {
+    std::deque<coro::prepared_coro> ready;
+    coro::memory_budget budget(1, [&](coro::prepared_coro c){ready.push_back(std::move(c));});
+    CHECK(budget.admit().is_ready());
+
+    coro::awaitable<int>::result trigger_result;
+    coro::awaitable<int> trigger([&](auto r){trigger_result = std::move(r);});
+    //start work, it will wait for trigger
+    auto w = work(budget, trigger).launch();
+    CHECK_GREATER(budget.get_live_bytes(), 0);
+
+    std::vector<int> order;
+    admitted(budget, order, 1);
+    admitted(budget, order, 2);
+    CHECK_EQUAL(budget.get_waiting(), 2);
+    CHECK(order.empty());
+    CHECK(!budget.admit().is_ready());
+
+    //finish work - frame is released, the first waiter is passed to the executor
+    trigger_result(42);
+    int r = coro::sync_await(w);
+    CHECK_EQUAL(r, 42);
+    CHECK(order.empty());
+    CHECK_EQUAL(ready.size(), 1);
+    //waiters are admitted in order, next one after previous one is suspended
+    while (!ready.empty()) {
+        auto c = std::move(ready.front());
+        ready.pop_front();
+        c.resume();
+    }
+    CHECK_EQUAL(budget.get_waiting(), 0);
+    CHECK_EQUAL(order.size(), 2);
+    CHECK_EQUAL(order[0], 1);
+    CHECK_EQUAL(order[1], 2);
+    CHECK_EQUAL(budget.get_live_bytes(), 0);
+}
+
+coro::coroutine<void, coro::budget_allocator<> > pool_work(coro::budget_allocator<>, coro::thread_pool &pool, std::atomic<int> &done) {
+    co_await coro::resume_on(pool);
+    done.fetch_add(1);
+}
+
+coro::coroutine<void> producer(coro::memory_budget &budget, coro::thread_pool &pool, std::atomic<int> &done, int count) {
+    for (int i = 0; i < count; ++i) {
+        co_await budget.admit();
+        pool_work(budget, pool, done);
+    }
+}
+
+void multi_thread_test() {
+    //frames are released in the pool while the producer waits on the gate (no lost wakeup)
+    constexpr int count = 20000;
+    coro::thread_pool pool(2);
+    coro::memory_budget budget(1, pool.get_executor());
+    std::atomic<int> done = {0};
+    producer(budget, pool, done, count).get();
+    while (done.load() != count || budget.get_live_bytes()) std::this_thread::yield();
+    int d = done.load();
+    CHECK_EQUAL(d, count);
+}
+
+int main() {
+    admit_test();
+    multi_thread_test();
+}
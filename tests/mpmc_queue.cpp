@@ -0,0 +1,272 @@
+#include <basic_coro/mpmc_queue.hpp>
+#include <basic_coro/scheduler.hpp>
+#include <basic_coro/select.hpp>
+#include <basic_coro/sync_await.hpp>
+#include "check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace coro;
+
+coroutine<void> push_coro(mpmc_queue<std::string, 4> &q) {
+    for (char c = '0'; c <='9'; ++c) {
+        co_await q.push(std::string(&c,1));
+    }
+    q.close();
+    co_return;
+}
+
+//producer suspends on full queue, consumer continues it
+void single_thread_test() {
+    mpmc_queue<std::string, 4> q;
+    push_coro(q);
+    std::string out;
+    awaitable<std::string> r = q.pop();
+    while (r.has_value()) {
+        out.append(r.await_resume());
+        r = q.pop();
+    }
+    CHECK_EQUAL(out, "0123456789");
+}
+
+coroutine<void> pop_coro(mpmc_queue<int, 3> &q, std::string &out) {
+    auto r = q.pop();
+    while (co_await r.ready()) {
+        out.push_back(static_cast<char>('0' + co_await r));
+        r = q.pop();
+    }
+}
+
+//consumer suspends on empty queue, producer hands over items
+void waiting_consumer_test() {
+    mpmc_queue<int, 3> q;
+    std::string out;
+    pop_coro(q, out);
+    for (int i = 0; i < 10; ++i) q.push(i);
+    q.close();
+    CHECK_EQUAL(out, "0123456789");
+}
+
+coroutine<void> producer(mpmc_queue<int, 16> &q, int base, int count) {
+    for (int i = 0; i < count; ++i) {
+        co_await q.push(base + i);
+    }
+}
+
+coroutine<long> consumer(mpmc_queue<int, 16> &q, int count) {
+    long sum = 0;
+    for (int i = 0; i < count; ++i) {
+        sum += co_await q.pop();
+    }
+    co_return sum;
+}
+
+//4 producers and 4 consumers, small capacity, so both waiter lists are used
+void multi_thread_test() {
+    constexpr int threads = 4;
+    constexpr int count = 20000;
+    mpmc_queue<int, 16> q;
+    std::atomic<long> sum = {0};
+    std::vector<std::thread> thrs;
+    for (int i = 0; i < threads; ++i) {
+        thrs.emplace_back([&, i]{
+            awaitable<void> p = producer(q, i * count, count);
+            sync_await(p);
+        });
+        thrs.emplace_back([&]{
+            awaitable<long> c = consumer(q, count);
+            sum += sync_await(c);
+        });
+    }
+    for (auto &t: thrs) t.join();
+    long n = static_cast<long>(threads) * count;
+    CHECK_EQUAL(sum.load(), n * (n - 1) / 2);
+}
+
+coroutine<void> batch_producer(mpmc_queue<int, 16> &q, int base, int count) {
+    std::vector<int> items;
+    for (int i = 0; i < count; i += 32) {
+        items.clear();
+        for (int j = i; j < std::min(i + 32, count); ++j) items.push_back(base + j);
+        co_await q.push_many(items);
+    }
+}
+
+coroutine<long> batch_consumer(mpmc_queue<int, 16> &q, int count) {
+    long sum = 0;
+    std::vector<int> buff(64);
+    while (count > 0) {
+        std::span<int> out(buff.data(), std::min<std::size_t>(buff.size(), count));
+        std::size_t n = co_await q.pop_many(out, std::min(count, 8));
+        for (std::size_t i = 0; i < n; ++i) sum += out[i];
+        count -= static_cast<int>(n);
+    }
+    co_return sum;
+}
+
+//batches larger than capacity, waiting batch consumers and producers
+void batch_multi_thread_test() {
+    constexpr int threads = 4;
+    constexpr int count = 20000;
+    mpmc_queue<int, 16> q;
+    std::atomic<long> sum = {0};
+    std::vector<std::thread> thrs;
+    for (int i = 0; i < threads; ++i) {
+        thrs.emplace_back([&, i]{
+            awaitable<void> p = batch_producer(q, i * count, count);
+            sync_await(p);
+        });
+        thrs.emplace_back([&]{
+            awaitable<long> c = batch_consumer(q, count);
+            sum += sync_await(c);
+        });
+    }
+    for (auto &t: thrs) t.join();
+    long n = static_cast<long>(threads) * count;
+    CHECK_EQUAL(sum.load(), n * (n - 1) / 2);
+}
+
+using time_point = std::chrono::system_clock::time_point;
+using ms = std::chrono::milliseconds;
+using manual_sched = manual_scheduler<time_point>;
+
+coroutine<void> timed_consumer(mpmc_queue<int, 4> &q, manual_sched &sch, std::vector<int> &out) {
+    while (true) {
+        auto r = q.pop_for(sch, ms(50));
+        bool ok = co_await r.ready();
+        if (!ok) break;
+        out.push_back(r.await_resume());
+    }
+    out.push_back(-1);
+}
+
+void pop_for_test() {
+    manual_sched sch;
+    mpmc_queue<int, 4> q;
+    std::vector<int> out;
+    q.push(1);
+    timed_consumer(q, sch, out);
+    //item was available, timer is not armed
+    CHECK_EQUAL(out.size(), 1);
+    CHECK(sch.get_first_scheduled_time().has_value());
+    q.push(2);
+    //timer of the second pop is canceled
+    CHECK_EQUAL(out.size(), 2);
+    while (sch.advance_time_until(time_point{} + ms(100)));
+    CHECK_EQUAL(out.size(), 3);
+    CHECK_EQUAL(out[2], -1);
+    //waiter has been removed, item stays in the queue
+    q.push(3);
+    auto r = q.pop();
+    CHECK(r.is_ready());
+    CHECK_EQUAL(r.await_resume(), 3);
+    //deadline
+    auto u = q.pop_until(sch, time_point{} + ms(150));
+    bool fired = false;
+    u >> [&](awaitable<int> &x){fired = !x.has_value();};
+    CHECK(!fired);
+    while (sch.advance_time_until(time_point{} + ms(200)));
+    CHECK(fired);
+    //closed queue, timer is not armed
+    q.close();
+    bool closed = false;
+    auto c = q.pop_for(sch, ms(50));
+    c >> [&](awaitable<int> &x){closed = !x.has_value();};
+    CHECK(closed);
+    CHECK(!sch.get_first_scheduled_time().has_value());
+}
+
+void push_for_test() {
+    manual_sched sch;
+    mpmc_queue<int, 2> q;
+    CHECK(q.push_for(sch, ms(50), 1).get());
+    CHECK(q.push_for(sch, ms(50), 2).get());
+    CHECK(!sch.get_first_scheduled_time().has_value());
+    bool res1 = false;
+    bool res2 = true;
+    auto p1 = q.push_for(sch, ms(50), 3);
+    p1 >> [&](awaitable<bool> &x){res1 = *x;};
+    auto p2 = q.push_for(sch, ms(100), 4);
+    p2 >> [&](awaitable<bool> &x){res2 = *x;};
+    //one slot released, first producer succeeds
+    int v = q.pop().get();
+    CHECK_EQUAL(v, 1);
+    CHECK(res1);
+    while (sch.advance_time_until(time_point{} + ms(200)));
+    CHECK(!res2);
+    v = q.pop().get();
+    CHECK_EQUAL(v, 2);
+    v = q.pop().get();
+    CHECK_EQUAL(v, 3);
+    CHECK(!q.pop().is_ready());
+}
+
+void select_test() {
+    mpmc_queue<int, 4> q1;
+    mpmc_queue<int, 4> q2;
+    q2.push(42);
+    auto r = sync_await(coro::select(q1.pop_case(), q2.pop_case()));
+    CHECK_EQUAL(r.index(), 1U);
+    CHECK_EQUAL(std::get<1>(r), 42);
+    //no waiter left in q1
+    q1.push(10);
+    auto a = q1.pop();
+    CHECK(a.is_ready());
+    CHECK_EQUAL(a.await_resume(), 10);
+    //push case wins on the queue which has a space
+    for (int i = 0; i < 4; ++i) q1.push(i);
+    auto p = sync_await(coro::select(q1.push_case(5), q2.push_case(6)));
+    CHECK_EQUAL(p.index(), 1U);
+    int v = q2.pop().get();
+    CHECK_EQUAL(v, 6);
+    CHECK(!q2.pop().is_ready());
+}
+
+//consumers select from two queues, producers push with a timeout, all on different threads
+void select_multi_thread_test() {
+    using mt_queue = mpmc_queue<int, 16>;
+    constexpr int count = 20000;
+    scheduler sch;
+    mt_queue q1;
+    mt_queue q2;
+    std::atomic<int> dropped = {0};
+    auto producer = [&](mt_queue &q, int base) {
+        for (int i = 0; i < count; ++i) {
+            //the timeout never expires, but the timer is armed and canceled when the queue is full
+            if (!q.push_for(sch, std::chrono::seconds(60), base + i).get()) ++dropped;
+        }
+    };
+    std::atomic<long long> sum = {0};
+    auto consumer = [&](int n) {
+        long long s = 0;
+        for (int i = 0; i < n; ++i) {
+            auto r = sync_await(coro::select(q1.pop_case(), q2.pop_case()));
+            s += r.index() == 0?std::get<0>(r):std::get<1>(r);
+        }
+        sum += s;
+    };
+    {
+        std::jthread p1([&]{producer(q1, 0);});
+        std::jthread p2([&]{producer(q2, count);});
+        std::jthread c1([&]{consumer(count);});
+        std::jthread c2([&]{consumer(count);});
+    }
+    long long expected = static_cast<long long>(2 * count - 1) * count;
+    CHECK_EQUAL(dropped.load(), 0);
+    CHECK_EQUAL(sum.load(), expected);
+}
+
+int main() {
+    single_thread_test();
+    waiting_consumer_test();
+    multi_thread_test();
+    batch_multi_thread_test();
+    pop_for_test();
+    push_for_test();
+    select_test();
+    select_multi_thread_test();
+}
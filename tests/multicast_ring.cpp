@@ -0,0 +1,212 @@
+#include <basic_coro/multicast_ring.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/sync_await.hpp>
+#include "check.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace coro;
+
+using ring_t = multicast_ring<int>;
+
+coroutine<void> collector(ring_t &ring, std::vector<int> &out, std::vector<const int *> &addr) {
+    ring_t::reader rd(ring);
+    while (true) {
+        auto r = rd.next();
+        if (!co_await r.ready()) break;
+        const int &v = r.await_resume();
+        out.push_back(v);
+        addr.push_back(&v);
+    }
+}
+
+void multicast_test() {
+    ring_t ring(4);
+    std::vector<int> out1, out2;
+    std::vector<const int *> addr1, addr2;
+    collector(ring, out1, addr1);
+    collector(ring, out2, addr2);
+    for (int i = 1; i <= 10; ++i) {
+        auto p = ring.publish(i);
+        CHECK(p.is_ready());
+    }
+    ring.close();
+    CHECK_EQUAL(out1.size(), 10U);
+    CHECK_EQUAL(out2.size(), 10U);
+    CHECK(out1 == out2);
+    CHECK_EQUAL(out1.back(), 10);
+    //both readers see the same slot
+    CHECK(addr1 == addr2);
+}
+
+coroutine<void> publisher(ring_t &ring, int from, int to, int &published) {
+    for (int i = from; i <= to; ++i) {
+        co_await ring.publish(i);
+        published = i;
+    }
+}
+
+void backpressure_test() {
+    ring_t ring(2);
+    ring_t::reader rd(ring);
+    int published = 0;
+    publisher(ring, 1, 3, published);
+    CHECK_EQUAL(published, 2);
+    auto r1 = rd.next();
+    CHECK_EQUAL(r1.await_resume(), 1);
+    //slot 1 is held
+    CHECK_EQUAL(published, 2);
+    auto r2 = rd.next();
+    CHECK_EQUAL(r2.await_resume(), 2);
+    CHECK_EQUAL(published, 3);
+    auto r3 = rd.next();
+    CHECK_EQUAL(r3.await_resume(), 3);
+    CHECK_EQUAL(rd.backlog(), 0U);
+}
+
+void lag_test() {
+    ring_t ring(4, multicast_overflow::lag);
+    ring_t::reader rd(ring);
+    for (int i = 1; i <= 10; ++i) {
+        auto p = ring.publish(i);
+        CHECK(p.is_ready());
+    }
+    auto r = rd.next();
+    const int &held = r.await_resume();
+    CHECK_EQUAL(held, 7);
+    CHECK_EQUAL(rd.lost(), 6U);
+    //publisher doesn't wait for the reader holding the oldest slot
+    int published = 0;
+    publisher(ring, 11, 14, published);
+    CHECK_EQUAL(published, 14);
+    //held value is not overwritten
+    CHECK_EQUAL(held, 7);
+    auto r2 = rd.next();
+    CHECK_EQUAL(r2.await_resume(), 11);
+    CHECK_EQUAL(rd.lost(), 9U);
+    CHECK_EQUAL(rd.backlog(), 3U);
+
+    //non-trivial values, more readers hold the same overwritten slot
+    multicast_ring<std::string> sring(2, multicast_overflow::lag);
+    multicast_ring<std::string>::reader rd1(sring);
+    multicast_ring<std::string>::reader rd2(sring);
+    sring.publish(std::string(100, 'a'));
+    auto s1 = rd1.next();
+    auto s2 = rd2.next();
+    const std::string &h1 = s1.await_resume();
+    const std::string &h2 = s2.await_resume();
+    for (int i = 0; i < 10; ++i) {
+        auto p = sring.publish(std::string(100, static_cast<char>('b' + i)));
+        CHECK(p.is_ready());
+    }
+    CHECK(h1 == std::string(100, 'a'));
+    CHECK_EQUAL(&h1, &h2);
+    auto s3 = rd1.next();
+    CHECK(s3.await_resume() == std::string(100, 'j'));
+    CHECK(h2 == std::string(100, 'a'));
+    auto s4 = rd2.next();
+    CHECK(s4.await_resume() == std::string(100, 'j'));
+    CHECK_EQUAL(rd1.lost(), 8U);
+    CHECK_EQUAL(rd2.lost(), 8U);
+}
+
+void lag_multi_thread_test() {
+    using mt_ring = multicast_ring<int, std::mutex>;
+    constexpr int count = 20000;
+    mt_ring ring(16, multicast_overflow::lag);
+    long long received = 0;
+    std::uint64_t lost = 0;
+    bool ordered = true;
+    std::atomic<bool> ready = {false};
+    std::jthread thr([&]{
+        mt_ring::reader rd(ring);
+        ready.store(true);
+        int last = -1;
+        while (true) {
+            auto r = rd.next();
+            r.wait();
+            if (!r.has_value()) break;
+            int v = r.await_resume();
+            ordered = ordered && v > last;
+            last = v;
+            ++received;
+            //slow reader
+            if (v % 64 == 0) std::this_thread::yield();
+        }
+        lost = rd.lost();
+    });
+    while (!ready.load()) std::this_thread::yield();
+    bool never_blocked = true;
+    for (int i = 0; i < count; ++i) never_blocked = ring.publish(i).is_ready() && never_blocked;
+    ring.close();
+    thr.join();
+    CHECK(never_blocked);
+    CHECK(ordered);
+    //every value was either received or reported as lost
+    CHECK_EQUAL(static_cast<std::uint64_t>(received) + lost, static_cast<std::uint64_t>(count));
+}
+
+void close_test() {
+    ring_t ring(4);
+    ring_t::reader rd(ring);
+    ring.publish(1);
+    ring.close();
+    auto p = ring.publish(2);
+    CHECK(p.is_ready());
+    CHECK(!p.has_value());
+    auto r1 = rd.next();
+    CHECK_EQUAL(r1.await_resume(), 1);
+    auto r2 = rd.next();
+    CHECK(r2.is_ready());
+    CHECK(!r2.has_value());
+}
+
+void multi_thread_test() {
+    using mt_ring = multicast_ring<int, std::mutex>;
+    constexpr int count = 20000;
+    constexpr int readers = 3;
+    mt_ring ring(64);
+    std::vector<long long> sums(readers);
+    std::vector<char> ordered(readers, true);
+    std::vector<std::jthread> thr;
+    std::atomic<int> ready = {0};
+    for (int i = 0; i < readers; ++i) {
+        thr.emplace_back([&, i]{
+            mt_ring::reader rd(ring);
+            ready.fetch_add(1);
+            int expect = 0;
+            while (true) {
+                auto r = rd.next();
+                r.wait();
+                if (!r.has_value()) break;
+                int v = r.await_resume();
+                ordered[i] = ordered[i] && v == expect;
+                ++expect;
+                sums[i] += v;
+            }
+        });
+    }
+    while (ready.load() != readers) std::this_thread::yield();
+    for (int i = 0; i < count; ++i) ring.publish(i).wait();
+    ring.close();
+    thr.clear();
+    long long expected = static_cast<long long>(count - 1) * count / 2;
+    for (int i = 0; i < readers; ++i) {
+        CHECK_EQUAL(sums[i], expected);
+        CHECK(ordered[i]);
+    }
+}
+
+int main() {
+    multicast_test();
+    backpressure_test();
+    lag_test();
+    lag_multi_thread_test();
+    close_test();
+    multi_thread_test();
+    return 0;
+}
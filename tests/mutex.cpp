@@ -1,5 +1,7 @@
 #include <basic_coro/mutex.hpp>
+#include <basic_coro/scheduler.hpp>
 #include "check.h"
+#include <thread>
 #include <vector>
 
 using namespace coro;
@@ -33,7 +35,65 @@ void test1() {
 }
 
 
+void lock_for_test() {
+    using time_point = std::chrono::system_clock::time_point;
+    using ms = std::chrono::milliseconds;
+    manual_scheduler<time_point> sch;
+    mutex mx;
+
+    auto l1 = mx.lock_for(sch, ms(10));
+    CHECK(l1.is_ready());
+    CHECK(!sch.get_first_scheduled_time().has_value());
+    mutex::ownership own = l1.get();
+    std::vector<int> res;
+    auto l2 = mx.lock_for(sch, ms(10));
+    auto l3 = mx.lock_for(sch, ms(100));
+    l2 >> [&](awaitable<mutex::ownership> &r){
+        res.push_back((*r).owns_lock()?2:-2);
+    };
+    l3 >> [&](awaitable<mutex::ownership> &r){
+        mutex::ownership o = *std::move(r);
+        res.push_back(o?3:-3);
+    };
+    while (sch.advance_time_until(time_point{} + ms(50)));
+    CHECK_EQUAL(res.size(), 1);
+    CHECK_EQUAL(res[0], -2);
+    //the timed out request is skipped
+    own.release();
+    CHECK_EQUAL(res.size(), 2);
+    CHECK_EQUAL(res[1], 3);
+    CHECK(!sch.get_first_scheduled_time().has_value());
+    CHECK(mx.try_lock().owns_lock());
+}
+
+void lock_for_threads_test() {
+    scheduler sch;
+    auto thr = sch.create_thread();
+    mutex mx;
+    int counter = 0;
+    std::atomic<int> locked = {};
+    auto worker = [&]{
+        for (int i = 0; i < 2000; ++i) {
+            mutex::ownership own = mx.lock_for(sch, std::chrono::microseconds(i % 50)).get();
+            if (own) {
+                ++counter;
+                ++locked;
+                //hold the lock, so other requests can time out
+                if (i % 7 == 0) std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        }
+    };
+    {
+        std::jthread t1(worker), t2(worker), t3(worker);
+    }
+    int total = locked.load();
+    CHECK_EQUAL(counter, total);
+    CHECK(mx.try_lock().owns_lock());
+}
+
 int main() {
     test1();
+    lock_for_test();
+    lock_for_threads_test();
     return 0;
 }
\ No newline at end of file
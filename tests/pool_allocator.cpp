@@ -0,0 +1,81 @@
+#include "check.h"
+#include <basic_coro/pool_allocator.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/awaitable.hpp>
+#include <basic_coro/co_switch.hpp>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+
+coro::coroutine<int, coro::pool_allocator> recursive_fibo(int val) {
+    if (val <= 1) {
+        co_return val;
+    }
+    co_await coro::co_switch();
+    int a = co_await recursive_fibo(val - 1);
+    int b = co_await recursive_fibo(val - 2);
+    co_return a+b;
+}
+
+coro::coroutine<int, coro::pool_allocator> simple_coro(int val) {
+    co_return val;
+}
+
+void cross_thread_test() {
+    std::vector<coro::coroutine<int, coro::pool_allocator> > coros;
+    for (int i = 0; i < 1000; ++i) coros.push_back(simple_coro(i));
+    //frames are released in other thread
+    std::thread thr([&]{
+        for (auto &c: coros) c.cancel();
+    });
+    thr.join();
+    int sum = 0;
+    for (int i = 0; i < 1000; ++i) sum += simple_coro(i).get();
+    CHECK_EQUAL(sum, 499500);
+}
+
+struct pool_probe: coro::pool_allocator {
+    static bool is_torn_down() {return torn_down();}
+};
+
+//releases blocks during static destruction, after the thread cache of the main thread is destroyed
+struct static_holder {
+    std::vector<void *> blocks;
+    ~static_holder() {
+        if (!pool_probe::is_torn_down()) {
+            std::cerr << "FAILED: thread cache is not torn down" << std::endl;
+            std::_Exit(1);
+        }
+        //more than cache_limit, the released cache must not be used
+        for (void *p: blocks) coro::pool_allocator::deallocate(p, 100);
+        void *p = coro::pool_allocator::allocate(100);
+        coro::pool_allocator::deallocate(p, 100);
+    }
+};
+
+static_holder holder;
+
+void teardown_test() {
+    for (std::size_t i = 0; i < coro::pool_allocator::cache_limit * 2; ++i) {
+        holder.blocks.push_back(coro::pool_allocator::allocate(100));
+    }
+    //the thread cache holds blocks at exit
+    for (int i = 0; i < 10; ++i) coro::pool_allocator::deallocate(coro::pool_allocator::allocate(200), 200);
+    CHECK(!pool_probe::is_torn_down());
+}
+
+int main() {
+    CHECK_EQUAL(coro::pool_allocator::size_class(1), 0);
+    CHECK_EQUAL(coro::pool_allocator::size_class(64), 0);
+    CHECK_EQUAL(coro::pool_allocator::size_class(65), 1);
+    void *a = coro::pool_allocator::allocate(100);
+    coro::pool_allocator::deallocate(a, 100);
+    void *b = coro::pool_allocator::allocate(120);
+    CHECK_EQUAL(a, b);
+    coro::pool_allocator::deallocate(b, 120);
+    int val = recursive_fibo(20);
+    CHECK_EQUAL(val, 6765);
+    cross_thread_test();
+    teardown_test();
+}
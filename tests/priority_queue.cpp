@@ -0,0 +1,75 @@
+#include <basic_coro/priority_queue.hpp>
+#include "check.h"
+
+#include <string>
+
+using namespace coro;
+
+struct message {
+    unsigned int prio;
+    char c;
+};
+
+struct message_prio {
+    unsigned int operator()(const message &m) const {return m.prio;}
+};
+
+using msg_queue = coro::priority_queue<message, 3, message_prio>;
+
+std::string drain(msg_queue &q) {
+    std::string out;
+    q.close();
+    awaitable<message> r = q.pop();
+    while (r.has_value()) {
+        out.push_back(r.await_resume().c);
+        r = q.pop();
+    }
+    return out;
+}
+
+void priority_test() {
+    msg_queue q;
+    q.push(message{2, 'a'});
+    q.push(message{2, 'b'});
+    q.push(message{1, 'c'});
+    q.push(message{0, 'd'});
+    q.push(message{1, 'e'});
+    q.push(message{7, 'f'});    //clamped to lowest priority
+    q.push(message{0, 'g'});
+    std::string out = drain(q);
+    CHECK_EQUAL(out, "dgceabf");
+}
+
+void aging_test() {
+    msg_queue q(2);
+    q.push(message{2, 'x'});
+    for (char c = 'a'; c <= 'f'; ++c) q.push(message{0, c});
+    q.push(message{1, 'y'});
+    //a level is served after it has been skipped twice, when more levels
+    //are starved, the higher priority goes first
+    std::string out = drain(q);
+    CHECK_EQUAL(out, "ayxbcdef");
+}
+
+coroutine<void> consumer(msg_queue &q, std::string &out) {
+    message m = co_await q.pop();
+    out.push_back(m.c);
+}
+
+void waiting_consumer_test() {
+    msg_queue q;
+    std::string out;
+    consumer(q, out);
+    q.push(message{2, 'a'});
+    CHECK_EQUAL(out, "a");
+    q.push(message{2, 'b'});
+    q.push(message{0, 'c'});
+    consumer(q, out);
+    CHECK_EQUAL(out, "ac");
+}
+
+int main() {
+    priority_test();
+    aging_test();
+    waiting_consumer_test();
+}
@@ -1,7 +1,11 @@
 #include <basic_coro/queue.hpp>
+#include <basic_coro/scheduler.hpp>
 #include <basic_coro/when_all.hpp>
 #include "check.h"
 
+#include <array>
+#include <vector>
+
 using namespace coro;
 
 coroutine<void> push_coro(coro::queue<char, 5> &q) {
@@ -73,10 +77,235 @@ void queue_push_test2() {
 
 }
 
+coroutine<void> pop_many_coro(coro::queue<int, 16> &q, std::string &out) {
+    std::array<int, 4> buff;
+    auto r = q.pop_many(buff, 3);
+    while (co_await r.ready()) {
+        std::size_t n = co_await r;
+        out.push_back(static_cast<char>('0' + n));
+        for (std::size_t i = 0; i < n; ++i) out.push_back(static_cast<char>('a' + buff[i]));
+        r = q.pop_many(buff, 3);
+    }
+}
+
+void queue_pop_many_test() {
+    coro::queue<int, 16> q;
+    std::string out;
+    pop_many_coro(q, out);
+    //consumer is resumed once it has 3 items
+    q.push(0);
+    q.push(1);
+    CHECK_EQUAL(out, "");
+    q.push(2);
+    CHECK_EQUAL(out, "3abc");
+    std::vector<int> items = {3,4,5,6,7,8,9};
+    q.push_many(items);
+    //consumer is resumed after all items are pushed, it takes the rest at once
+    CHECK_EQUAL(out, "3abc3def4ghij");
+    q.push(10);
+    //closing returns what has been received
+    q.close();
+    CHECK_EQUAL(out, "3abc3def4ghij1k");
+}
+
+coroutine<void> push_many_coro(coro::queue<int, 3> &q, std::vector<int> items) {
+    co_await q.push_many(items);
+    q.close();
+}
+
+void queue_push_many_test() {
+    coro::queue<int, 3> q;
+    push_many_coro(q, {0,1,2,3,4,5,6,7,8,9});
+    std::string out;
+    std::array<int, 4> buff;
+    while (true) {
+        awaitable<std::size_t> r = q.pop_many(buff);
+        if (!r.has_value()) break;
+        std::size_t n = r.await_resume();
+        out.push_back(static_cast<char>('0' + n));
+        for (std::size_t i = 0; i < n; ++i) out.push_back(static_cast<char>('a' + buff[i]));
+    }
+    //the queue holds 3 items, pop_many refills it from waiting producer
+    CHECK_EQUAL(out, "4abcd4efgh2ij");
+}
+
+coroutine<void> dynamic_push_coro(coro::dynamic_queue<int> &q, int &pushed) {
+    for (int i = 0; i < 10; ++i) {
+        co_await q.push(i);
+        ++pushed;
+    }
+    q.close();
+}
+
+void dynamic_queue_test() {
+    coro::dynamic_queue<int> q(3);
+    CHECK_EQUAL(q.get_capacity(), 4U);
+    int pushed = 0;
+    dynamic_push_coro(q, pushed);
+    //producer is blocked by full queue
+    CHECK_EQUAL(pushed, 4);
+    std::string out;
+    awaitable<int> r = q.pop();
+    while (r.has_value()) {
+        out.push_back(static_cast<char>('0' + r.await_resume()));
+        r = q.pop();
+    }
+    CHECK_EQUAL(out, "0123456789");
+}
+
+//unlimited queue must keep FIFO order across chunks and when it is refilled
+void unlimited_queue_fifo_test() {
+    coro::queue<int> q;
+    int next_push = 0;
+    int next_pop = 0;
+    bool ok = true;
+    for (int round = 0; round < 20; ++round) {
+        int cnt = round % 2?37:5000;
+        for (int i = 0; i < cnt; ++i) q.push(next_push++);
+        for (int i = 0; i < cnt / 2 + 1; ++i) {
+            awaitable<int> r = q.pop();
+            ok = ok && r.has_value() && r.await_resume() == next_pop;
+            ++next_pop;
+        }
+    }
+    while (next_pop < next_push) {
+        awaitable<int> r = q.pop();
+        ok = ok && r.has_value() && r.await_resume() == next_pop;
+        ++next_pop;
+    }
+    CHECK(ok);
+}
+
+using time_point = std::chrono::system_clock::time_point;
+using ms = std::chrono::milliseconds;
+using manual_sched = manual_scheduler<time_point>;
+
+coroutine<void> timed_consumer(coro::queue<int> &q, manual_sched &sch, std::vector<int> &out) {
+    while (true) {
+        auto r = q.pop_for(sch, ms(50));
+        bool ok = co_await r.ready();
+        if (!ok) break;
+        out.push_back(r.await_resume());
+    }
+    out.push_back(-1);
+}
+
+void queue_pop_for_test() {
+    manual_sched sch;
+    coro::queue<int> q;
+    std::vector<int> out;
+    q.push(1);
+    timed_consumer(q, sch, out);
+    //item was available, timer is not armed
+    CHECK_EQUAL(out.size(), 1);
+    CHECK(sch.get_first_scheduled_time().has_value());
+    q.push(2);
+    //timer of the second pop is canceled
+    CHECK_EQUAL(out.size(), 2);
+    while (sch.advance_time_until(time_point{} + ms(100)));
+    CHECK_EQUAL(out.size(), 3);
+    CHECK_EQUAL(out[2], -1);
+    //waiter has been removed, item stays in the queue
+    q.push(3);
+    auto r = q.pop();
+    CHECK(r.is_ready());
+    CHECK_EQUAL(r.await_resume(), 3);
+    //deadline
+    auto u = q.pop_until(sch, time_point{} + ms(150));
+    bool fired = false;
+    u >> [&](awaitable<int> &x){fired = !x.has_value();};
+    CHECK(!fired);
+    while (sch.advance_time_until(time_point{} + ms(200)));
+    CHECK(fired);
+}
+
+void queue_push_for_test() {
+    manual_sched sch;
+    coro::queue<int, 2> q;
+    CHECK(q.push_for(sch, ms(50), 1).get());
+    CHECK(q.push_for(sch, ms(50), 2).get());
+    CHECK(!sch.get_first_scheduled_time().has_value());
+    bool res1 = false;
+    bool res2 = true;
+    auto p1 = q.push_for(sch, ms(50), 3);
+    p1 >> [&](awaitable<bool> &x){res1 = *x;};
+    auto p2 = q.push_for(sch, ms(100), 4);
+    p2 >> [&](awaitable<bool> &x){res2 = *x;};
+    //one slot released, first producer succeeds
+    int v = q.pop().get();
+    CHECK_EQUAL(v, 1);
+    CHECK(res1);
+    while (sch.advance_time_until(time_point{} + ms(200)));
+    CHECK(!res2);
+    v = q.pop().get();
+    CHECK_EQUAL(v, 2);
+    v = q.pop().get();
+    CHECK_EQUAL(v, 3);
+    CHECK(!q.pop().is_ready());
+}
+
+using stats_queue = coro::queue<int, 2, empty_lockable, queue_stats<> >;
+
+coroutine<void> stats_producer(stats_queue &q, int v) {
+    co_await q.push(v);
+}
+
+coroutine<void> stats_consumer(stats_queue &q, int &v) {
+    v = co_await q.pop();
+}
+
+template<typename H>
+std::uint64_t histogram_total(const H &h) {
+    std::uint64_t r = 0;
+    for (auto x: h) r += x;
+    return r;
+}
+
+void queue_stats_test() {
+    stats_queue q;
+    q.push(1);
+    q.push(2);
+    stats_producer(q, 3);
+    auto s = q.get_stats().snapshot();
+    CHECK_EQUAL(s.depth, 2U);
+    CHECK_EQUAL(s.high_water, 2U);
+    CHECK_EQUAL(s.waiting_producers, 1U);
+    CHECK_EQUAL(s.waiting_consumers, 0U);
+    for (int i = 1; i <= 3; ++i) {
+        int v = q.pop().await_resume();
+        CHECK_EQUAL(v, i);
+    }
+    s = q.get_stats().snapshot();
+    CHECK_EQUAL(s.depth, 0U);
+    CHECK_EQUAL(s.waiting_producers, 0U);
+    CHECK_EQUAL(s.items, 3U);
+    CHECK_EQUAL(histogram_total(s.item_time), 3U);
+    CHECK_EQUAL(histogram_total(s.producer_wait), 1U);
+    int v = 0;
+    stats_consumer(q, v);
+    s = q.get_stats().snapshot();
+    CHECK_EQUAL(s.waiting_consumers, 1U);
+    q.push(4);
+    CHECK_EQUAL(v, 4);
+    s = q.get_stats().snapshot();
+    CHECK_EQUAL(s.waiting_consumers, 0U);
+    CHECK_EQUAL(s.items, 4U);
+    CHECK_EQUAL(histogram_total(s.consumer_wait), 1U);
+    //item handed over directly, so it didn't spend time in the queue
+    CHECK(s.item_time[0] >= 1U);
+    CHECK_EQUAL(s.high_water, 2U);
+}
 
 int main() {
     queue_push_test();
     queue_push_test2();
     queue_pop_test();
+    queue_pop_many_test();
+    queue_push_many_test();
+    unlimited_queue_fifo_test();
+    dynamic_queue_test();
+    queue_pop_for_test();
+    queue_push_for_test();
+    queue_stats_test();
     return 0;
 }
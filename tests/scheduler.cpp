@@ -3,19 +3,26 @@
 
 #include "check.h"
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <span>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace coro;
 
 
-awaitable<unsigned int> coro_test(scheduler &sch, unsigned int ms, unsigned int id) {
+template<typename Sch>
+awaitable<unsigned int> coro_test(Sch &sch, unsigned int ms, unsigned int id) {
     co_await sch.sleep_for(std::chrono::milliseconds(ms));
     co_return id;
 }
 
 
-awaitable<void> coro_test_master(scheduler &sch, std::ostream &out) {
+template<typename Sch>
+awaitable<void> coro_test_master(Sch &sch, std::ostream &out) {
     awaitable<unsigned int>lst[] = {
             coro_test(sch,1000,1),
             coro_test(sch,500,2),
@@ -34,11 +41,77 @@ awaitable<void> coro_test_master(scheduler &sch, std::ostream &out) {
 
 
 
+coroutine<void> batch_sleeper(scheduler &sch, scheduler::time_point tp, std::atomic<int> &done) {
+    bool r = co_await sch.sleep_until(tp);
+    if (r) done.fetch_add(1);
+}
+
+//timers which expire at the same time are passed to the executor as one batch
+void batch_test() {
+    constexpr int count = 100;
+    scheduler sch;
+    std::atomic<int> done = {0};
+    std::vector<std::size_t> batches;
+    auto tp = scheduler::clock::now() + std::chrono::milliseconds(50);
+    for (int i = 0; i < count; ++i) batch_sleeper(sch, tp, done);
+    {
+        std::stop_source stp;
+        std::jthread thr([&]{
+            sch.run_thread([&](std::span<prepared_coro> b){batches.push_back(b.size());}, stp.get_token());
+        });
+        while (done.load() < count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stp.request_stop();
+    }
+    CHECK_EQUAL(batches.size(), 1U);
+    CHECK_EQUAL(batches[0], static_cast<std::size_t>(count));
+}
+
+//generic lambda receives coroutines one by one
+void generic_executor_test() {
+    constexpr int count = 3;
+    scheduler sch;
+    std::atomic<int> done = {0};
+    std::mutex mx;
+    std::vector<prepared_coro> queue;
+    auto tp = scheduler::clock::now() + std::chrono::milliseconds(10);
+    for (int i = 0; i < count; ++i) batch_sleeper(sch, tp, done);
+    {
+        std::stop_source stp;
+        std::jthread thr([&]{
+            sch.run_thread([&](auto &&c){
+                std::lock_guard _(mx);
+                queue.push_back(std::move(c));
+            }, stp.get_token());
+        });
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard _(mx);
+            if (queue.size() == count) break;
+        }
+        stp.request_stop();
+    }
+    CHECK_EQUAL(done.load(), 0);
+    for (auto &c: queue) c.resume();
+    CHECK_EQUAL(done.load(), count);
+}
+
 int main() {
+    batch_test();
+    generic_executor_test();
+    {
+        //time point of other clock is converted
+        scheduler sch;
+        bool r = sch.await(sch.sleep_until(std::chrono::system_clock::now() + std::chrono::milliseconds(20)));
+        CHECK(r);
+    }
     std::ostringstream buff;
     scheduler sch;
     sch.await(coro_test_master(sch,buff));
     CHECK(buff.str() == "6|2|4|5|1|3|");
+    std::ostringstream buff2;
+    basic_scheduler<timing_wheel> wsch(std::chrono::milliseconds(1));
+    wsch.await(coro_test_master(wsch,buff2));
+    CHECK(buff2.str() == "6|2|4|5|1|3|");
     return 0;
 }
 
@@ -0,0 +1,137 @@
+#include <basic_coro/queue.hpp>
+#include <basic_coro/scheduler.hpp>
+#include <basic_coro/select.hpp>
+#include "check.h"
+
+#include <mutex>
+#include <thread>
+
+using namespace coro;
+
+using time_point = std::chrono::system_clock::time_point;
+using ms = std::chrono::milliseconds;
+
+void ready_test() {
+    queue<int> q1;
+    queue<int> q2;
+    q2.push(42);
+    auto r = sync_await(coro::select(q1.pop_case(), q2.pop_case()));
+    CHECK_EQUAL(r.index(), 1U);
+    CHECK_EQUAL(std::get<1>(r), 42);
+    //no waiter left in q1
+    q1.push(10);
+    auto a = q1.pop();
+    CHECK(a.is_ready());
+    CHECK_EQUAL(a.await_resume(), 10);
+}
+
+coroutine<void> selector(queue<int> &q1, queue<int> &q2, int &idx, int &val) {
+    auto r = co_await coro::select(q1.pop_case(), q2.pop_case());
+    idx = static_cast<int>(r.index());
+    val = r.index() == 0?std::get<0>(r):std::get<1>(r);
+}
+
+void waiting_test() {
+    queue<int> q1;
+    queue<int> q2;
+    int idx = -1;
+    int val = 0;
+    selector(q1, q2, idx, val);
+    CHECK_EQUAL(idx, -1);
+    q2.push(7);
+    CHECK_EQUAL(idx, 1);
+    CHECK_EQUAL(val, 7);
+    //the item is not consumed by withdrawn case
+    q1.push(8);
+    auto a = q1.pop();
+    CHECK(a.is_ready());
+    CHECK_EQUAL(a.await_resume(), 8);
+}
+
+using sched_t = manual_scheduler<time_point>;
+
+coroutine<void> timed_selector(queue<int> &q, sched_t &sch, int &idx) {
+    auto r = co_await coro::select(q.pop_case(), coro::sleep_case(sch, ms(50)));
+    idx = static_cast<int>(r.index());
+}
+
+void timeout_test() {
+    sched_t sch;
+    queue<int> q;
+    int idx = -1;
+    timed_selector(q, sch, idx);
+    CHECK(sch.get_first_scheduled_time().has_value());
+    while (sch.advance_time_until(time_point{} + ms(100)));
+    CHECK_EQUAL(idx, 1);
+    q.push(1);
+    auto a = q.pop();
+    CHECK(a.is_ready());
+    //item before timeout, timer is canceled
+    idx = -1;
+    timed_selector(q, sch, idx);
+    q.push(2);
+    CHECK_EQUAL(idx, 0);
+    CHECK(!sch.get_first_scheduled_time().has_value());
+    //item is ready, timer is not armed
+    q.push(3);
+    idx = -1;
+    timed_selector(q, sch, idx);
+    CHECK_EQUAL(idx, 0);
+    CHECK(!sch.get_first_scheduled_time().has_value());
+}
+
+void closed_test() {
+    queue<int> q1;
+    queue<int> q2;
+    q1.close();
+    bool canceled = false;
+    try {
+        sync_await(coro::select(q1.pop_case(), q2.pop_case()));
+    } catch (const await_canceled_exception &) {
+        canceled = true;
+    }
+    CHECK(canceled);
+}
+
+void multi_thread_test() {
+    using mt_queue = queue<int, 16, std::mutex>;
+    constexpr int count = 20000;
+    mt_queue q1;
+    mt_queue q2;
+    auto producer = [](mt_queue &q, int base) {
+        for (int i = 0; i < count; ++i) q.push(base + i).wait();
+    };
+    std::jthread p1([&]{producer(q1, 0);});
+    std::jthread p2([&]{producer(q2, count);});
+    long long sum = 0;
+    int from_q1 = 0;
+    int next1 = 0;
+    int next2 = count;
+    bool ordered = true;
+    for (int i = 0; i < 2 * count; ++i) {
+        auto r = sync_await(coro::select(q1.pop_case(), q2.pop_case()));
+        int v;
+        if (r.index() == 0) {
+            v = std::get<0>(r);
+            ordered = ordered && v == next1++;
+            ++from_q1;
+        } else {
+            v = std::get<1>(r);
+            ordered = ordered && v == next2++;
+        }
+        sum += v;
+    }
+    long long expected = static_cast<long long>(2 * count - 1) * count;
+    CHECK_EQUAL(sum, expected);
+    CHECK_EQUAL(from_q1, count);
+    CHECK(ordered);
+}
+
+int main() {
+    ready_test();
+    waiting_test();
+    timeout_test();
+    closed_test();
+    multi_thread_test();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <basic_coro/shared_mutex.hpp>
+#include <basic_coro/coroutine.hpp>
+#include "check.h"
+#include <thread>
+#include <vector>
+
+using namespace coro;
+
+void shared_test() {
+    shared_mutex mx;
+    auto r1 = mx.lock_shared();
+    auto r2 = mx.lock_shared();
+    CHECK(r1.is_ready());
+    CHECK(r2.is_ready());
+    shared_mutex::shared_ownership o1 = r1.get();
+    shared_mutex::shared_ownership o2 = r2.get();
+    CHECK(!mx.try_lock());
+    o1.release();
+    CHECK(!mx.try_lock());
+    o2.release();
+    auto w = mx.try_lock();
+    CHECK(w.owns_lock());
+    CHECK(!mx.try_lock_shared());
+    w.release();
+    CHECK(mx.try_lock_shared().owns_lock());
+}
+
+coroutine<void> reader(shared_mutex &mx, std::vector<int> &res, int id) {
+    auto own = co_await mx.lock_shared();
+    res.push_back(id);
+}
+
+coroutine<void> writer(shared_mutex &mx, std::vector<int> &res, int id) {
+    auto own = co_await mx.lock();
+    res.push_back(id);
+}
+
+void writer_preference_test() {
+    shared_mutex mx;
+    std::vector<int> res;
+    shared_mutex::shared_ownership own = mx.lock_shared().get();
+    writer(mx, res, 100);
+    //writer is waiting, new readers are queued
+    reader(mx, res, 1);
+    reader(mx, res, 2);
+    CHECK(res.empty());
+    CHECK(!mx.try_lock_shared());
+    own.release();
+    CHECK_EQUAL(res.size(), 3U);
+    CHECK_EQUAL(res[0], 100);
+    CHECK_EQUAL(res[1], 1);
+    CHECK_EQUAL(res[2], 2);
+}
+
+void batch_test() {
+    shared_mutex mx;
+    std::vector<int> res;
+    shared_mutex::ownership own = mx.lock().get();
+    reader(mx, res, 1);
+    reader(mx, res, 2);
+    writer(mx, res, 100);
+    reader(mx, res, 3);
+    reader(mx, res, 4);
+    CHECK(res.empty());
+    //readers at head of the queue are granted together, later readers wait for the writer
+    own.release();
+    CHECK_EQUAL(res.size(), 5U);
+    CHECK_EQUAL(res[0], 1);
+    CHECK_EQUAL(res[1], 2);
+    CHECK_EQUAL(res[2], 100);
+    CHECK_EQUAL(res[3], 3);
+    CHECK_EQUAL(res[4], 4);
+}
+
+void multi_thread_test() {
+    constexpr int threads = 4;
+    constexpr int count = 20000;
+    shared_mutex mx;
+    long long a = 0;
+    long long b = 0;
+    std::atomic<int> mismatches = {0};
+    std::vector<std::jthread> thr;
+    for (int t = 0; t < threads; ++t) {
+        thr.emplace_back([&, t]{
+            for (int i = 0; i < count; ++i) {
+                if ((i + t) % 4 == 0) {
+                    auto own = mx.lock().get();
+                    ++a;
+                    ++b;
+                } else {
+                    auto own = mx.lock_shared().get();
+                    if (a != b) mismatches.fetch_add(1);
+                }
+            }
+        });
+    }
+    thr.clear();
+    int m = mismatches.load();
+    CHECK_EQUAL(m, 0);
+    CHECK_EQUAL(a, static_cast<long long>(threads) * count / 4);
+    CHECK_EQUAL(a, b);
+}
+
+int main() {
+    shared_test();
+    writer_preference_test();
+    batch_test();
+    multi_thread_test();
+    return 0;
+}
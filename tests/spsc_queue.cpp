@@ -0,0 +1,66 @@
+#include <basic_coro/spsc_queue.hpp>
+#include <basic_coro/sync_await.hpp>
+#include "check.h"
+
+#include <string>
+#include <thread>
+
+using namespace coro;
+
+coroutine<void> push_coro(spsc_queue<std::string, 4> &q) {
+    for (char c = '0'; c <='9'; ++c) {
+        co_await q.push(std::string(&c,1));
+    }
+    q.close();
+    co_return;
+}
+
+void single_thread_test() {
+    spsc_queue<std::string, 4> q;
+    push_coro(q);
+    std::string out;
+    awaitable<std::string> r = q.pop();
+    while (r.has_value()) {
+        out.append(r.await_resume());
+        r = q.pop();
+    }
+    CHECK_EQUAL(out, "0123456789");
+}
+
+coroutine<void> producer(spsc_queue<int, 8> &q, int count) {
+    for (int i = 0; i < count; ++i) {
+        co_await q.push(i);
+    }
+    q.close();
+}
+
+coroutine<int> consumer(spsc_queue<int, 8> &q) {
+    int expect = 0;
+    int errors = 0;
+    auto r = q.pop();
+    while (co_await r.ready()) {
+        if (co_await r != expect) ++errors;
+        ++expect;
+        r = q.pop();
+    }
+    co_return errors + (expect != 100000);
+}
+
+//producer and consumer in different threads, items must arrive in order
+void two_threads_test() {
+    spsc_queue<int, 8> q;
+    int errors = -1;
+    std::thread thr([&]{
+        awaitable<int> c = consumer(q);
+        errors = sync_await(c);
+    });
+    awaitable<void> p = producer(q, 100000);
+    sync_await(p);
+    thr.join();
+    CHECK_EQUAL(errors, 0);
+}
+
+int main() {
+    single_thread_test();
+    two_threads_test();
+}
@@ -0,0 +1,113 @@
+#include <basic_coro/thread_pool.hpp>
+#include <basic_coro/coroutine.hpp>
+#include <basic_coro/scheduler.hpp>
+#include <basic_coro/sync_await.hpp>
+
+#include "check.h"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+coro::coroutine<int> square(int x) {
+    co_return x * x;
+}
+
+//spawns children inside the pool (local enqueue, stealing)
+coro::coroutine<long> fan_out(coro::thread_pool &pool, int count) {
+    co_await coro::resume_on(pool);
+    CHECK(coro::thread_pool::current() == &pool);
+    std::deque<coro::pending<coro::awaitable<int> > > children;
+    for (int i = 0; i < count; ++i) children.emplace_back(square(i), pool);
+    long sum = 0;
+    for (auto &c: children) sum += co_await c;
+    co_return sum;
+}
+
+coro::coroutine<bool> hop(coro::thread_pool &pool) {
+    auto id1 = std::this_thread::get_id();
+    co_await coro::resume_on(pool);
+    auto id2 = std::this_thread::get_id();
+    //already in the pool, no suspension
+    co_await coro::resume_on(pool);
+    co_return id1 != id2 && pool.is_current();
+}
+
+coro::coroutine<bool> sleeper(coro::scheduler &sch, coro::thread_pool &pool) {
+    co_await sch.sleep_for(std::chrono::milliseconds(10));
+    co_return pool.is_current();
+}
+
+void parallel_test(coro::thread_pool &pool) {
+    constexpr int tasks = 1000;
+    std::atomic<int> done = {0};
+    std::vector<std::thread::id> ids(tasks);
+    {
+        std::deque<coro::pending<coro::awaitable<int> > > lst;
+        for (int i = 0; i < tasks; ++i) {
+            lst.emplace_back([](int i, std::vector<std::thread::id> &ids, std::atomic<int> &done)->coro::coroutine<int> {
+                ids[i] = std::this_thread::get_id();
+                done.fetch_add(1);
+                co_return i;
+            }(i, ids, done), pool);
+        }
+        int sum = 0;
+        for (auto &p: lst) sum += coro::sync_await(p);
+        CHECK_EQUAL(sum, tasks * (tasks - 1) / 2);
+    }
+    CHECK_EQUAL(done.load(), tasks);
+    bool all_in_pool = true;
+    for (auto &id: ids) all_in_pool = all_in_pool && id != std::this_thread::get_id();
+    CHECK(all_in_pool);
+}
+
+void deque_test() {
+    coro::work_stealing_deque dq(2);
+    std::vector<int> frames(100);
+    for (auto &f: frames) dq.push(std::coroutine_handle<>::from_address(&f));
+    CHECK_EQUAL(dq.size(), 100U);
+    //thief takes the oldest, owner the newest
+    CHECK(dq.steal().address() == &frames.front());
+    CHECK(dq.pop().address() == &frames.back());
+    std::size_t cnt = 0;
+    while (dq.pop()) ++cnt;
+    CHECK_EQUAL(cnt, 98U);
+    CHECK(dq.empty());
+    CHECK(!dq.steal());
+}
+
+int main() {
+    deque_test();
+    coro::thread_pool pool(4);
+    CHECK_EQUAL(pool.get_thread_count(), 4U);
+    CHECK(!pool.is_current());
+    parallel_test(pool);
+    coro::awaitable<bool> h = hop(pool);
+    CHECK(coro::sync_await(h));
+    coro::awaitable<long> f = fan_out(pool, 500);
+    CHECK_EQUAL(coro::sync_await(f), 41541750L);
+    auto sq = square(7).launch(pool);
+    CHECK_EQUAL(coro::sync_await(sq), 49);
+    coro::scheduler sch;
+    {
+        std::stop_source stp;
+        std::jthread thr([&]{sch.run_thread(pool, stp.get_token());});
+        coro::awaitable<bool> s = sleeper(sch, pool);
+        CHECK(coro::sync_await(s));
+        stp.request_stop();
+    }
+    {
+        //batch mode
+        std::stop_source stp;
+        std::jthread thr([&]{sch.run_thread(pool, stp.get_token());});
+        coro::awaitable<bool> s = sleeper(sch, pool);
+        CHECK(coro::sync_await(s));
+        stp.request_stop();
+    }
+    {
+        auto thr = sch.create_thread(pool.get_executor());
+        coro::awaitable<bool> s = sleeper(sch, pool);
+        CHECK(coro::sync_await(s));
+    }
+}
@@ -0,0 +1,168 @@
+#include <basic_coro/scheduler.hpp>
+
+#include "check.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace coro;
+
+using time_point = std::chrono::steady_clock::time_point;
+using ms = std::chrono::milliseconds;
+
+//compares the wheel with the heap by random operations
+void compare_with_heap() {
+    generic_scheduler<int, time_point, const void *> heap;
+    timing_wheel<int, time_point, const void *> wheel(ms(1));
+    std::vector<char> idents(2001);
+    std::mt19937 rnd(42);
+    time_point now = time_point{} + std::chrono::hours(1000);
+    int next = 1;
+    bool same = true;
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            //whole milliseconds, so rounding to ticks doesn't change the order
+            time_point tp = now + ms(rnd() % 100000);
+            const void *id = &idents[static_cast<std::size_t>(next)];
+            heap.schedule_at(next, tp, id);
+            wheel.schedule_at(next, tp, id);
+            ++next;
+        }
+        for (int i = 0; i < 3; ++i) {
+            const void *id = &idents[rnd() % static_cast<unsigned int>(next)];
+            int a = heap.remove_by_ident(id);
+            int b = wheel.remove_by_ident(id);
+            same = same && a == b;
+        }
+        for (int i = 0; i < 3; ++i) {
+            //move timers, also before current time
+            const void *id = &idents[rnd() % static_cast<unsigned int>(next)];
+            time_point tp = now + ms(rnd() % 100000) - ms(1000);
+            same = same && heap.set_time(id, tp) == wheel.set_time(id, tp);
+        }
+        same = same && wheel.get_first_scheduled_time() == heap.get_first_scheduled_time();
+        now += ms(rnd() % 2000);
+        std::vector<int> ha, wa;
+        while (heap.get_first_scheduled_time() && *heap.get_first_scheduled_time() <= now) {
+            auto th = heap.get_first_scheduled_time();
+            auto tw = wheel.get_first_scheduled_time();
+            same = same && tw && *th == *tw;
+            ha.push_back(heap.remove_first());
+            wa.push_back(wheel.remove_first());
+        }
+        //items of the same time can be ordered differently
+        std::sort(ha.begin(), ha.end());
+        std::sort(wa.begin(), wa.end());
+        same = same && ha == wa;
+        same = same && wheel.get_first_scheduled_time() == heap.get_first_scheduled_time();
+    }
+    CHECK(same);
+    CHECK(!wheel.empty());
+    std::size_t cnt = wheel.size();
+    while (!wheel.empty()) {
+        wheel.remove_first();
+        --cnt;
+    }
+    CHECK_EQUAL(cnt, 0U);
+}
+
+void order_and_rounding() {
+    timing_wheel<int, time_point, const void *> wheel(ms(10));
+    time_point base = time_point{} + std::chrono::seconds(100);
+    wheel.schedule_at(1, base + ms(15), nullptr);
+    wheel.schedule_at(2, base + ms(12), nullptr);
+    wheel.schedule_at(3, base + std::chrono::hours(48), nullptr);
+    wheel.schedule_at(4, base + ms(5), nullptr);
+    //rounded up to tick boundary, never early
+    CHECK(*wheel.get_first_scheduled_time() == base + ms(10));
+    int r = wheel.remove_first();
+    CHECK_EQUAL(r, 4);
+    //same tick - insertion order
+    CHECK(*wheel.get_first_scheduled_time() == base + ms(20));
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 1);
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 2);
+    //timer in the past is served first
+    wheel.schedule_at(5, base, nullptr);
+    CHECK(*wheel.get_first_scheduled_time() == base);
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 5);
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 3);
+    CHECK(wheel.empty());
+}
+
+void set_time_test() {
+    timing_wheel<int, time_point, const void *> wheel;
+    int a, b;
+    time_point base = time_point{} + std::chrono::seconds(100);
+    wheel.schedule_at(1, base + ms(100), &a);
+    wheel.schedule_at(2, base + ms(200), &b);
+    CHECK(wheel.set_time(&b, base + ms(50)));
+    CHECK(!wheel.set_time(nullptr, base));
+    int r = wheel.remove_first();
+    CHECK_EQUAL(r, 2);
+    r = wheel.remove_by_ident(&a);
+    CHECK_EQUAL(r, 1);
+    CHECK(wheel.empty());
+}
+
+void early_timers_test() {
+    timing_wheel<int, time_point, const void *> wheel(ms(1));
+    int a, b, c;
+    time_point base = time_point{} + std::chrono::hours(1000);
+    wheel.schedule_at(1, base + std::chrono::hours(1), &a);
+    wheel.schedule_at(2, base + std::chrono::hours(2), &b);
+    //cancel the earliest timer, the next one is found
+    int r = wheel.remove_by_ident(&a);
+    CHECK_EQUAL(r, 1);
+    CHECK(*wheel.get_first_scheduled_time() == base + std::chrono::hours(2));
+    //timers before the position of the wheel keep their time and order
+    wheel.schedule_at(3, base + ms(10), &c);
+    wheel.schedule_at(4, base + ms(5), nullptr);
+    wheel.schedule_at(5, base + ms(5), nullptr);
+    CHECK(*wheel.get_first_scheduled_time() == base + ms(5));
+    CHECK(wheel.set_time(&b, base + ms(7)));
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 4);
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 5);
+    CHECK(*wheel.get_first_scheduled_time() == base + ms(7));
+    r = wheel.remove_by_ident(&c);
+    CHECK_EQUAL(r, 3);
+    r = wheel.remove_first();
+    CHECK_EQUAL(r, 2);
+    CHECK(wheel.empty());
+    CHECK(!wheel.get_first_scheduled_time());
+}
+
+awaitable<bool> sleeper(manual_scheduler<time_point, timing_wheel> &sch, ms dur, cancel_signal *sig) {
+    co_return co_await sch.sleep_for(dur, sig);
+}
+
+void manual_test() {
+    manual_scheduler<time_point, timing_wheel> sch(ms(1));
+    cancel_signal sig;
+    auto s1 = sleeper(sch, ms(100), nullptr);
+    auto s2 = sleeper(sch, ms(50), &sig);
+    bool r1 = false, r2 = true;
+    s1 >> [&](auto &&x){r1 = x.await_resume();};
+    s2 >> [&](auto &&x){r2 = x.await_resume();};
+    sch.cancel(&sig);
+    CHECK(!r2);
+    while (sch.advance_time_until(time_point{} + ms(1000)));
+    CHECK(r1);
+    CHECK(sch.get_current_time() == time_point{} + ms(1000));
+}
+
+int main() {
+    order_and_rounding();
+    set_time_test();
+    early_timers_test();
+    compare_with_heap();
+    manual_test();
+    return 0;
+}
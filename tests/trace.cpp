@@ -2,6 +2,7 @@
 #ifdef BASIC_CORO_ENABLE_TRACE
 #include <coroutine>
 #include <source_location>
+#include <string_view>
 #endif
 
 #ifdef BASIC_CORO_ENABLE_TRACE
@@ -38,4 +39,7 @@ void basic_coro_trace_exception(std::coroutine_handle<> h) noexcept {
 void basic_coro_trace_setname(std::coroutine_handle<> h, std::string_view name) noexcept {
     std::cout << "Set name of  coro: " << h << " = " << name <<  std::endl;
 }
+void basic_coro_trace_callback_spill(std::string_view callback_type, std::size_t callback_size, std::size_t reserved_space) noexcept {
+    std::cout << "Callback spill: " << callback_type << " size " << callback_size << " > " << reserved_space << std::endl;
+}
 #endif
\ No newline at end of file